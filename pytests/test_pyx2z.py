@@ -1,5 +1,8 @@
 """ test the pyx2z module
 """
+import os
+import glob
+import contextlib
 import numpy
 import pyx2z
 
@@ -50,6 +53,89 @@ def test__MolecOrient_sym_num():
     assert o.sym_num() == 2
 
 
+def test__MolecOrient_sym_num_engines():
+    """ cross-check pyx2z.MolecOrient.sym_num() engines on the examples
+    """
+    for path in _example_files():
+        asymbs, coords = _read_xyz(path)
+        m = _molec_geom_obj(asymbs, coords)
+        o = pyx2z.MolecOrient(m)
+        ref = o.sym_num()
+        o.set_engine(pyx2z.MolecOrient.GRAPH)
+        assert o.engine() == pyx2z.MolecOrient.GRAPH
+        assert o.sym_num() == ref, path
+
+
+def test__MolecOrient_top():
+    """ test pyx2z.MolecOrient.top(), principal_moment(), and principal_axes(),
+    and the asymmetric top sym_num() against the full reference frames search
+    """
+    asymm = pyx2z.MolecOrient.ASYMMETRIC_TOP
+    symm = pyx2z.MolecOrient.SYMMETRIC_TOP
+    tops = {'water': asymm, 'c2h3': asymm, 'c3h5': asymm, 'ccc': asymm,
+            'alkoxy': asymm, 'ch2o+oh': asymm, 'hnco+oh': asymm,
+            'allene': symm, 'h2co': symm, 'egdn': symm,
+            'ch4': pyx2z.MolecOrient.SPHERICAL_TOP}
+    geoms = {'water': (['O', 'H', 'H'],
+                       [(-1.2516025626, 2.3683550357, 0.0000000000),
+                        (-0.2816025626, 2.3683550357, 0.0000000000),
+                        (-1.5749323743, 3.2380324089, -0.2828764736)])}
+    for path in _example_files():
+        name = os.path.splitext(os.path.basename(path))[0]
+        geoms[name] = _read_xyz(path)
+    for name, (asymbs, coords) in geoms.items():
+        m = _molec_geom_obj(asymbs, coords)
+        o = pyx2z.MolecOrient(m)
+        if o.is_linear():
+            continue
+        assert o.top() == tops[name], name
+        pm = [o.principal_moment(i) for i in range(3)]
+        pa = numpy.array(o.principal_axes())
+        assert pm == sorted(pm)
+        assert numpy.allclose(pa.dot(pa.T), numpy.eye(3), atol=1e-6)
+        assert o.sym_num() == pyx2z.compare(o, o, pyx2z.MolecOrient.SYMNUM)
+
+
+def test__MolecOrient_sym_ops():
+    """ test pyx2z.MolecOrient.sym_ops(), improper_ops(), and point_group()
+    """
+    asymbs = ['O', 'H', 'H']
+    coords = [(-1.2516025626,  2.3683550357,  0.0000000000),
+              (-0.2816025626,  2.3683550357,  0.0000000000),
+              (-1.5749323743,  3.2380324089, -0.2828764736)]
+    m = _molec_geom_obj(asymbs, coords)
+    o = pyx2z.MolecOrient(m)
+    ops = o.sym_ops()
+    iops = o.improper_ops()
+    assert [op.perm for op in ops] == [[0, 1, 2], [0, 2, 1]]
+    assert sorted(op.perm for op in iops) == [[0, 1, 2], [0, 2, 1]]
+    for op in ops + iops:
+        rot = numpy.array(op.rot)
+        assert numpy.allclose(rot.dot(rot.T), numpy.eye(3), atol=1e-6)
+        assert numpy.allclose(numpy.linalg.det(rot), 1. if op.proper else -1.)
+    assert [op.order() for op in ops] == [1, 2]
+    assert o.point_group() == 'C2v'
+    assert o.sym_num() == len(ops)
+
+
+def test__MolecOrient_sym_num_order():
+    """ test that pyx2z.MolecOrient.sym_num() does not depend on the sym_ops()
+    call order
+    """
+    for path in _example_files():
+        asymbs, coords = _read_xyz(path)
+        m = _molec_geom_obj(asymbs, coords)
+        o = pyx2z.MolecOrient(m)
+        before = o.sym_num()
+        nops = len(o.sym_ops())
+        assert o.sym_num() == before, path
+        o = pyx2z.MolecOrient(m)
+        assert len(o.sym_ops()) == nops, path
+        assert o.sym_num() == before, path
+        if not o.is_linear():
+            assert nops == before, path
+
+
 def test__MolecOrient_is_enantiomer():
     """ test pyx2z.MolecOrient.is_enantiomer()
     """
@@ -243,20 +329,167 @@ def test__MolecStruct_atom_ordering():
 def test__MolecStruct_resonance_count():
     """ test pyx2z.MolecStruct.resonance_count()
     """
-    asymbs = ['C', 'C', 'C', 'H', 'H', 'H', 'H', 'H']
-    coords = [(1.10206, 0.05263, 0.02517),
-              (2.44012, 0.03045, 0.01354),
-              (3.23570, 0.06292, 1.20436),
-              (2.86296, -0.38925, 2.11637),
-              (4.29058, 0.30031, 1.12619),
-              (0.54568, -0.01805, -0.90370),
-              (0.53167, 0.14904, 0.94292),
-              (2.97493, -0.03212, -0.93001)]
+    asymbs, coords = _allyl()
     m = _molec_geom_obj(asymbs, coords)
     s = pyx2z.MolecStruct(m, [])
     assert s.resonance_count() == 2
 
 
+def test__MolecStruct_resonance_method():
+    """ test pyx2z.set_resonance_method()
+    """
+    asymbs, coords = _allyl()
+    m = _molec_geom_obj(asymbs, coords)
+    assert pyx2z.resonance_method() == pyx2z.ResonanceMethod.MATCHING
+    with _settings(method=pyx2z.ResonanceMethod.BFS):
+        s = pyx2z.MolecStruct(m, [])
+    t = pyx2z.MolecStruct(m, [])
+    assert s.resonance_count() == t.resonance_count() == 2
+    assert numpy.allclose(s.resonance_averaged_bond_order(0, 1),
+                          t.resonance_averaged_bond_order(0, 1))
+
+
+def test__MolecStruct_resonance_limit():
+    """ test pyx2z.set_resonance_limit() and pyx2z.MolecStruct.resonances()
+    """
+    asymbs, coords = _allyl()
+    m = _molec_geom_obj(asymbs, coords)
+    s = pyx2z.MolecStruct(m, [])
+    assert not s.is_resonance_truncated()
+    assert len(list(s.resonances())) == 2
+    with _settings(limit=1):
+        t = pyx2z.MolecStruct(m, [])
+    assert t.resonance_count() == 1
+    assert t.is_resonance_truncated()
+    assert len(list(t.resonances())) == 2
+
+
+def test__MolecStruct_resonance_time_limit():
+    """ test pyx2z.set_resonance_time_limit(): the truncated enumeration
+    keeps maximal pi bond placements only
+    """
+    asymbs = ['C'] * 6 + ['H'] * 6
+    coords = [(1.39 * numpy.cos(k * numpy.pi / 3.),
+               1.39 * numpy.sin(k * numpy.pi / 3.), 0.) for k in range(6)]
+    coords += [(2.47 * numpy.cos(k * numpy.pi / 3.),
+                2.47 * numpy.sin(k * numpy.pi / 3.), 0.) for k in range(6)]
+    m = _molec_geom_obj(asymbs, coords)
+    for method in (pyx2z.ResonanceMethod.MATCHING, pyx2z.ResonanceMethod.BFS):
+        with _settings(method=method, time_limit=1.e-9):
+            s = pyx2z.MolecStruct(m, [])
+        assert s.is_resonance_truncated()
+        assert s.resonance_count() == 1
+        pi_bonds = sum(s.resonance_averaged_bond_order(k, (k + 1) % 6) - 1.
+                       for k in range(6))
+        assert numpy.allclose(pi_bonds, 3.)
+        assert not any(s.is_radical(k) for k in range(6))
+
+
+def test__MolecStruct_resonance_threads():
+    """ test the breadth-first resonances enumeration on several threads
+    """
+    for path in _example_files():
+        if os.path.basename(os.path.dirname(path)) == 'ts':
+            continue
+        asymbs, coords = _read_xyz(path)
+        m = _molec_geom_obj(asymbs, coords)
+        with _settings(method=pyx2z.ResonanceMethod.BFS, thread_count=1):
+            s = pyx2z.MolecStruct(m, [])
+        with _settings(method=pyx2z.ResonanceMethod.BFS, thread_count=4):
+            t = pyx2z.MolecStruct(m, [])
+        assert s.resonance_count() == t.resonance_count()
+        assert pyx2z.zmatrix_string(s) == pyx2z.zmatrix_string(t)
+
+
+def test__MolecStruct_update_zmat_coval():
+    """ test pyx2z.MolecStruct.update_zmat_coval()
+    """
+    for asymbs, coords, shifted in _zmat_frames():
+        m = _molec_geom_obj(asymbs, coords)
+        n = _molec_geom_obj(asymbs, shifted)
+        s = pyx2z.MolecStruct(m, [])
+        s.update_zmat_coval(n)
+        t = pyx2z.MolecStruct(n, [])
+        assert pyx2z.zmatrix_string(s) == pyx2z.zmatrix_string(t)
+
+
+def test__MolecStruct_zmat_trajectory():
+    """ test pyx2z.MolecStruct.zmat_trajectory() against zmat_coval()
+    """
+    for asymbs, coords, shifted in _zmat_frames():
+        m = _molec_geom_obj(asymbs, coords)
+        n = _molec_geom_obj(asymbs, shifted)
+        s = pyx2z.MolecStruct(m, [])
+        table = s.zmat_trajectory(numpy.array([_bohr(coords),
+                                               _bohr(shifted)]))
+        assert table.shape == (2, len(s.zmat_var()))
+        assert numpy.allclose(table[0], _zmat_var_values(s))
+        s.update_zmat_coval(n)
+        assert numpy.allclose(table[1], _zmat_var_values(s))
+
+
+def test__MolecStruct_zmat_cartesian():
+    """ test pyx2z.MolecStruct.zmat_cartesian() by the round trip through
+    zmat_trajectory() and, for the chiral CHFClBr, by the handedness
+    """
+    asymbs = ['C', 'H', 'F', 'Cl', 'Br']
+    coords = [(0.000, 0.000, 0.000),
+              (0.629, 0.629, 0.629),
+              (-0.780, -0.780, 0.780),
+              (-1.017, 1.017, -1.017),
+              (1.118, -1.118, -1.118)]
+    geoms = [(asymbs, coords), _allyl()]
+    geoms += [(asymbs, coords) for asymbs, coords, _ in _zmat_frames()]
+    for asymbs, coords in geoms:
+        m = _molec_geom_obj(asymbs, coords)
+        s = pyx2z.MolecStruct(m, [])
+        table = s.zmat_trajectory(numpy.array([_bohr(coords)]))
+        xyz = s.zmat_cartesian(numpy.vstack([table, table]))
+        assert xyz.shape == (2, len(asymbs), 3)
+        assert numpy.allclose(xyz[0], xyz[1])
+        diff = s.zmat_trajectory(xyz) - table
+        assert numpy.allclose(numpy.remainder(diff + 180., 360.) - 180., 0.,
+                              atol=1.e-6)
+    asymbs, coords = geoms[0]
+    m = _molec_geom_obj(asymbs, coords)
+    s = pyx2z.MolecStruct(m, [])
+    xyz = s.zmat_cartesian(s.zmat_trajectory(numpy.array([_bohr(coords)])))
+    orig = pyx2z.MolecOrient(m)
+    rebuilt = pyx2z.MolecOrient(
+        _molec_geom_obj(asymbs, numpy.divide(xyz[0], _bohr(1.))))
+    mirror = pyx2z.MolecOrient(
+        _molec_geom_obj(asymbs, numpy.multiply(coords, (1., 1., -1.))))
+    assert pyx2z.compare(orig, rebuilt, pyx2z.MolecOrient.TEST)
+    assert not pyx2z.compare(orig, mirror, pyx2z.MolecOrient.TEST)
+
+
+def test__RotorScan():
+    """ test pyx2z.RotorScan
+    """
+    asymbs = ['C', 'C', 'H', 'H', 'H', 'H', 'H', 'H']
+    coords = [(0.000000, 0.000000, 0.000000),
+              (0.000000, 0.000000, 1.530000),
+              (1.027670, 0.000000, -0.363311),
+              (-0.513835, 0.889988, -0.363311),
+              (-0.513835, -0.889988, -0.363311),
+              (0.513835, 0.889988, 1.893311),
+              (-1.027670, 0.000000, 1.893311),
+              (0.513835, -0.889988, 1.893311)]
+    m = _molec_geom_obj(asymbs, coords)
+    s = pyx2z.MolecStruct(m, [])
+    grid = [[30. * k for k in range(12)]]
+    scan = pyx2z.RotorScan(s, grid)
+    points = [incr for geom, incr in scan]
+    assert points == [[0.], [30.], [60.], [90.]]
+    assert scan.skipped() == 8
+    assert len(list(pyx2z.RotorScan(s, grid, False))) == 12
+    asymbs, coords = _propene()
+    s = pyx2z.MolecStruct(_molec_geom_obj(asymbs, coords), [])
+    scan = pyx2z.RotorScan(s, grid)
+    assert len(list(scan)) == 4
+    assert scan.skipped() == 8
+
+
 def test__zmatrix_string():
     """ test pyx2z.zmatrix_sring()
     """
@@ -318,6 +551,29 @@ def test__rotational_group_indices():
     print(indices)
 
 
+@contextlib.contextmanager
+def _settings(method=None, thread_count=None, limit=None, time_limit=None):
+    """ change the module-wide pyx2z settings, restoring them on exit
+    """
+    saved = (pyx2z.resonance_method(), pyx2z.thread_count(),
+             pyx2z.resonance_limit(), pyx2z.resonance_time_limit())
+    try:
+        if method is not None:
+            pyx2z.set_resonance_method(method)
+        if thread_count is not None:
+            pyx2z.set_thread_count(thread_count)
+        if limit is not None:
+            pyx2z.set_resonance_limit(limit)
+        if time_limit is not None:
+            pyx2z.set_resonance_time_limit(time_limit)
+        yield
+    finally:
+        pyx2z.set_resonance_method(saved[0])
+        pyx2z.set_thread_count(saved[1])
+        pyx2z.set_resonance_limit(saved[2])
+        pyx2z.set_resonance_time_limit(saved[3])
+
+
 def _molec_geom_obj(asymbs, coords):
     _mg = pyx2z.MolecGeom()
     for asymb, xyz in zip(asymbs, coords):
@@ -326,13 +582,84 @@ def _molec_geom_obj(asymbs, coords):
     return _mg
 
 
+def _allyl():
+    asymbs = ['C', 'C', 'C', 'H', 'H', 'H', 'H', 'H']
+    coords = [(1.10206, 0.05263, 0.02517),
+              (2.44012, 0.03045, 0.01354),
+              (3.23570, 0.06292, 1.20436),
+              (2.86296, -0.38925, 2.11637),
+              (4.29058, 0.30031, 1.12619),
+              (0.54568, -0.01805, -0.90370),
+              (0.53167, 0.14904, 0.94292),
+              (2.97493, -0.03212, -0.93001)]
+    return asymbs, coords
+
+
+def _propene():
+    asymbs = ['C', 'C', 'C', 'H', 'H', 'H', 'H', 'H', 'H']
+    coords = [(0.00000, 0.00000, 0.00000),
+              (1.33500, 0.00000, 0.00000),
+              (2.10000, 1.28000, 0.00000),
+              (-0.55000, 0.93000, 0.00000),
+              (-0.55000, -0.93000, 0.00000),
+              (1.88000, -0.94000, 0.00000),
+              (3.17000, 1.08000, 0.00000),
+              (1.85000, 1.87000, 0.88000),
+              (1.85000, 1.87000, -0.88000)]
+    return asymbs, coords
+
+
+def _zmat_frames():
+    """ geometries with dihedral angles (propene) and dummy atoms (allene),
+    each with a slightly distorted copy keeping the z-matrix structure
+    """
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        os.pardir, 'examples')
+    frames = []
+    for asymbs, coords in [_propene(),
+                           _read_xyz(os.path.join(root, 'allene.xyz'))]:
+        shift = 0.02 * numpy.sin(numpy.arange(3 * len(coords)))
+        shifted = numpy.add(coords, shift.reshape(-1, 3))
+        frames.append((asymbs, coords, [tuple(xyz) for xyz in shifted]))
+    return frames
+
+
+def _zmat_var_values(s):
+    coval = s.zmat_coval()
+    return [coval[v % 3, v // 3] for v in s.zmat_var()]
+
+
+def _example_files():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        os.pardir, 'examples')
+    return sorted(glob.glob(os.path.join(root, '*.xyz')) +
+                  glob.glob(os.path.join(root, 'ts', '*.xyz')))
+
+
+def _read_xyz(path):
+    with open(path) as xyz_file:
+        lines = xyz_file.read().splitlines()
+    natoms = int(lines[0])
+    asymbs = []
+    coords = []
+    for line in lines[2:2+natoms]:
+        words = line.split()
+        asymbs.append(words[0])
+        coords.append(tuple(map(float, words[1:4])))
+    return asymbs, coords
+
+
 def _atom_obj(asymb, xyz):
-    _ang2bohr = 1.8897259886
     _a = pyx2z.Atom(asymb)
-    _a[0], _a[1], _a[2] = numpy.multiply(xyz, _ang2bohr)
+    _a[0], _a[1], _a[2] = _bohr(xyz)
     return _a
 
 
+def _bohr(coords):
+    _ang2bohr = 1.8897259886
+    return numpy.multiply(coords, _ang2bohr)
+
+
 if __name__ == '__main__':
     test__PrimStruct_is_connected()
     test__PrimStruct_connected_group()
@@ -1,5 +1,6 @@
 #include "chem.hh"
 #include "units.hh"
+#include "thread.hh"
 
 #include <iostream>
 #include <iomanip>
@@ -7,6 +8,10 @@
 #include <set>
 #include <map>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <queue>
+#include <functional>
 
 /*********************** Atomic coordinates accuracies *******************/
 
@@ -14,6 +19,22 @@ double angle_tolerance = 5.0;
 
 double distance_tolerance = 0.05;
 
+resonance_method_t resonance_method = RESONANCE_MATCHING;
+
+int    resonance_limit      = 0;
+double resonance_time_limit = 0.;
+
+// resonances enumeration time limit check
+//
+bool resonance_time_over (std::chrono::steady_clock::time_point start)
+{
+  if(resonance_time_limit <= 0.)
+    //
+    return false;
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > resonance_time_limit;
+}
+
 bool are_angles_equal (double a1, double a2)
 {
   double da = a2 - a1;
@@ -70,1495 +91,4252 @@ void MolecGeom::operator *= (double d)
     *at *= d;
 }
 
-MolecOrient::MolecOrient (const MolecGeom& m)  : MolecGeom(m) 
+AtomSignature::AtomSignature (const MolecGeom& m, int at) : _atom(m[at])
 {
-  const char funame [] = "MolecOrient::MolecOrient (const MolecGeom&): ";
-
-  int    itemp;
-  
-  double dtemp;
-  
-  bool   btemp;
-
-  int min_ind;
+  reserve(m.size() - 1);
   
-  double min_val;
-  bool istart;
-
-  MolecGeom& m1 = *this;
-
-  for(int i = 0; i < size(); ++i)
-    if(m1[i] == AtomBase::DUMMY) {
-      std::cout << funame << "no dummies, please\n";
-      throw Error::Range();
-    }
+  for(int i = 0; i < m.size(); ++i)
+    //
+    if(i != at)
+      //
+      push_back(std::make_pair((const AtomBase&)m[i], vdistance(m[at], m[i])));
 
-  if(size() < 2 ) {
-    std::cout << funame << "wrong number of atoms\n";
-    throw Error::Range();
-  }
+  std::sort(begin(), end());
+}
 
-  m1 -= m[0];
+bool AtomSignature::match (const AtomSignature& s, double tol) const
+{
+  if(_atom != s._atom || size() != s.size())
+    //
+    return false;
 
-  const double len0 = m1[1].vlength();
-  if(are_distances_equal(len0, 0.)) {
-    std::cout << funame << "atoms are too close\n";
-    throw Error::Range();
-  }
+  for(const_iterator it = begin(), sit = s.begin(); it != end(); ++it, ++sit) {
+    //
+    if(it->first != sit->first)
+      //
+      return false;
 
-  if(size() == 2) {// diatomic
-    _mt = LINEAR;
-    for(int i = 0; i < 3; ++i)
-      if(!i)
-	m1[1][i] = len0;
-      else
-	m1[1][i] = 0.;
-    return;
-  }
+    const double dd = it->second - sit->second;
 
-  // is geometry linear?
-  istart = true;
-  for(int at = 2; at < size(); ++at) {
-    dtemp = std::fabs(90. - angle(m1[1], m1[0], m1[at]));
-    if(istart || dtemp < min_val) {
-      istart = false;
-      min_ind = at;
-      min_val = dtemp;
-    }
+    if(dd >= tol || dd <= -tol)
+      //
+      return false;
   }
 
-  /************************ Linear geometry ******************************/
-
-  if(are_angles_equal(min_val, 90.)) {// linear geometry
-    _mt = LINEAR;
+  return true;
+}
 
-    // orient along x axis
-    D3::Vector n0 = m1[1];
-    n0 /= len0;
-    for(int at = 1; at < size(); ++at)
-      for(int i = 0; i < 3; ++i)
-	if(!i)
-	  m1[at][i] = vdot(m1[at], n0);
-	else
-	  m1[at][i] = 0.;
+bool AtomGrid::Key::operator== (const Key& k) const
+{
+  return atom == k.atom && isot == k.isot && cell[0] == k.cell[0] && cell[1] == k.cell[1] && cell[2] == k.cell[2];
+}
 
-    // sorting atoms
-    std::vector<double> coor(size());
-    for(int at = 0; at < size(); ++at)
-      coor[at] = m1[at][0];
+std::size_t AtomGrid::KeyHash::operator() (const Key& k) const
+{
+  std::size_t res = k.atom * 1000 + k.isot;
 
-    std::vector<int> perm(size());
-    my_sort(coor, perm);
+  for(int i = 0; i < 3; ++i)
+    //
+    res = res * 73856093 ^ (std::size_t)k.cell[i];
 
-    MolecGeom m(size());
-    
-    for(int at = 0; at < size(); ++at)
-      //
-      m[at] = m1[perm[at]];
-    
-    m1 = m;
+  return res;
+}
 
-    /*
-      std::cout << funame << "x-coordinates:";
+AtomGrid::Key AtomGrid::_key (const AtomBase& a, const double* r) const
+{
+  Key res;
 
-    for(int a = 0; a < size(); ++a)
-      //
-      std::cout << "   " << m1[a][0];
+  res.atom = _typed ? a.number()  : 0;
 
-    std::cout << "\n";
-    */
-    
-    return;
-  }
-		
-  /************************* Nonlinear geometry **************************/
+  res.isot = _typed ? a.isotope() : 0;
 
-  // change atoms order
-  //
-  if(min_ind != 2)
+  for(int i = 0; i < 3; ++i)
     //
-    std::swap(m1[2], m1[min_ind]);
+    res.cell[i] = (long)std::floor(r[i] / _cell);
 
-  m1 *= D3::Matrix(m1[1], m1[2]); // standard orientation
+  return res;
+}
 
-  // reference atoms distance matrix
-  //
-  for(int i = 0; i < 3; ++i)
-    //
-    _dm[i] = vdistance(m1[(i+1)%3], m1[(i+2)%3]);
+AtomGrid::AtomGrid (const MolecGeom& m, double c, bool typed) : _cell(c), _typed(typed)
+{
+  const char funame [] = "AtomGrid::AtomGrid: ";
 
-  // is molecule plane?
-  //
-  _mt = PLANE;
-  
-  if(size() == 3)
+  if(_cell <= 0.) {
     //
-    return;
+    std::cerr << funame << "cell size out of range: " << _cell << "\n";
 
-  for(int a = 3; a < size(); ++a)
+    throw Error::Range();
+  }
+  
+  for(int at = 0; at < m.size(); ++at)
     //
-    if(!are_distances_equal(m1[a][2], 0.)) {
-      //
-      _mt = NONLINEAR;
-      
-      break;
-    }
-} 
+    _map[_key(m[at], m[at])].push_back(at);
+}
 
-int  MolecOrient::sym_num () const 
+void AtomGrid::find (const AtomBase& a, const double* r, std::vector<int>& res) const
 {
-  return compare(*this, *this, SYMNUM); 
+  _find(_key(a, r), res);
 }
 
-bool MolecOrient::is_enantiomer () const 
+void AtomGrid::find (const double* r, std::vector<int>& res) const
 {
-  if(_mt == NONLINEAR) {
+  const char funame [] = "AtomGrid::find: ";
+
+  if(_typed) {
     //
-    MolecGeom m = *this;
-    
-    m *= -1.;
-    
-    return !compare(*this, MolecOrient(m), TEST);
+    std::cerr << funame << "atom type is needed for the typed grid\n";
+
+    throw Error::Logic();
   }
-  
-  return false;
-}
 
-int compare (const MolecOrient& m1, const MolecOrient& m2, 
-	     MolecOrient::mode_t mode) 
-{
-  const char funame [] = "MolecOrient::compare: ";
+  Key center;
 
-  int    itemp;
-  double dtemp;
-  bool   btemp;
+  center.atom = center.isot = 0;
 
-  if(m1.size() < 2 || m2.size() < 2) {
+  for(int i = 0; i < 3; ++i)
     //
-    std::cerr << funame << "wrong number of atoms\n";
-    
-    throw Error::Range();
-  }
+    center.cell[i] = (long)std::floor(r[i] / _cell);
 
-  if(m1.size() != m2.size())
-    //
-    return 0;
-    
-  if(m1._mt != m2._mt)
-    //
-    return 0;
+  _find(center, res);
+}
 
-  int result = 0;
+void AtomGrid::_find (const Key& center, std::vector<int>& res) const
+{
+  res.clear();
 
-  /************************ Linear geometry ************************/
+  Key k = center;
 
-  if(m1._mt == MolecOrient::LINEAR) {
+  for(int i = -1; i < 2; ++i) {
     //
-    btemp = true;
+    k.cell[0] = center.cell[0] + i;
     
-    for(int at = 1; at < m1.size(); ++at)
+    for(int j = -1; j < 2; ++j) {
       //
-      if(m1[at] != m2[at] || !are_distances_equal(m1[at][0] - m1[0][0], m2[at][0] - m2[0][0])) {
+      k.cell[1] = center.cell[1] + j;
+      
+      for(int l = -1; l < 2; ++l) {
 	//
-	btemp = false;
+	k.cell[2] = center.cell[2] + l;
 
-	break;
+	_map_t::const_iterator it = _map.find(k);
+
+	if(it != _map.end())
+	  //
+	  res.insert(res.end(), it->second.begin(), it->second.end());
       }
-    
-    if(btemp) {
-      //
-      ++result;
-      
-      if(mode == MolecOrient::TEST)
-	//
-	return 1;
     }
+  }
+}
 
-    btemp = true;
-    
-    for(int at = 1; at < m1.size(); ++at)
-      //
-      if(m1[at] != m2[m1.size() - at - 1] || !are_distances_equal(m1[at][0] - m1[0][0], m2[m1.size() - 1][0] - m2[m1.size() - at - 1][0])) {
-	//
-	btemp = false;
+// scratch buffers for the reference frame matching: the atoms are transformed to the
+// reference atoms frame on demand, and the buffers are reused by all frames
+//
+struct FrameScratch {
+  //
+  std::vector<D3::Vector> pos; // atoms in the current frame
+
+  std::vector<int> pos_stamp; // frame for which the position is computed
+
+  std::vector<int> used; // frame for which the atom is already matched
+
+  std::vector<int> perm; // matching permutation
+
+  std::vector<int> near; // atoms in the neighboring grid cells
+
+  int frame;
+
+  explicit FrameScratch (int n) : pos(n), pos_stamp(n, -1), used(n, -1), frame(0) { perm.reserve(n); near.reserve(n); }
+};
+
+// does m1 coincide with m2 in the standard orientation frame of m2 reference atoms;
+// dm1 is m1 reference atoms distance matrix, the grid is the spatial hash of m2
+// atoms with the cell size slightly larger than the distance tolerance
+//
+bool frame_match (const MolecGeom& m1, const double* dm1, const MolecGeom& m2, const AtomGrid& grid,
+		  const int* ref, FrameScratch& sc)
+{
+  std::vector<int>& perm = sc.perm;
+
+  perm.resize(3);
 	
-	break;
-      }
-    
-    if(btemp)
+  for(int i = 0; i < 3; ++i)
+    //
+    perm[i] = ref[i];
+  
+  // checking if reference atoms are the same
+  //
+  for(int i = 0; i < 3; ++i)
+    //
+    if(m1[i] != m2[perm[i]])
       //
-      ++result;
-
-    return result;
-  }
-    
-  /************************ Nonlinear geometry ************************/
+      return false;
 
-  //distance matrix
+  // checking if the distances between reference atoms are the same
   //
-  ConMat<double> tdm(m2.size());
-  
-  for(int i = 0; i < m2.size(); ++i)
+  for(int i = 0; i < 3; ++i)
     //
-    for(int j = i+1; j < m2.size(); ++j)
+    if(!are_distances_equal(dm1[i], vdistance(m2[perm[(i + 1) % 3]], m2[perm[(i + 2) % 3]])))
       //
-      tdm(i,j) = vdistance(m2[i], m2[j]);
+      return false;
 
-  // three reference atoms cycle
+  // standard orientation
   //
-  int count = 0;
+  const int frame = ++sc.frame;
+	
+  D3::Vector v1 = m2[perm[1]];
+
+  v1 -= m2[perm[0]];
+
+  D3::Vector v2 = m2[perm[2]];
+
+  v2 -= m2[perm[0]];
+
+  const D3::Matrix rot(v1, v2);
+
+  for(int i = 0; i < 3; ++i)
+    //
+    sc.used[perm[i]] = frame;
+
+  // checking if the rest of the atoms coincide
+  //
+  for(int rest = 3; rest < m1.size(); ++rest) {
+    //
+    int    match = -1;
+	  
+    double min_dist;
+
+    // position in m2 frame
+    //
+    D3::Vector r = m1[rest] * rot;
+
+    r += m2[perm[0]];
+
+    grid.find(m1[rest], r, sc.near);
   
-  for(int at0 = 0; at0 < m2.size(); ++at0) {
+    // best matching atom
     //
-    for(int at1 = 0; at1 < m2.size(); ++at1) {
+    for(std::vector<int>::const_iterator nit = sc.near.begin(); nit != sc.near.end(); ++nit) {
       //
-      if(at0 == at1)
+      const int test = *nit;
+	    
+      if(sc.used[test] == frame)
 	//
 	continue;
-      
-      for(int at2 = 0; at2 < m2.size(); ++at2) {
+
+      if(sc.pos_stamp[test] != frame) {
 	//
-	if(at2 == at1 || at2 == at0)
-	  //
-	  continue;
+	sc.pos_stamp[test] = frame;
+	      
+	sc.pos[test] = m2[test];
 
-	std::vector<int> perm(3);
-	
-	perm[0] = at0;
-	perm[1] = at1;
-	perm[2] = at2;
+	sc.pos[test] -= m2[perm[0]];
 
-	// checking if reference atoms are the same
-	//
-	btemp = false;
-	
-	for(int i = 0; i < 3; ++i) {
-	  //
-	  if(m1[i] != m2[perm[i]]) {
-	    //
-	    btemp = true;
+	sc.pos[test] *= rot;
+      }
 	    
-	    break;
-	  }
-	}
-	
-	if(btemp)
-	  //
-	  continue;
-
-	// checking if the distances between reference atoms are the same
-	//
-	double dm2[3];
-	
-	for(int i = 0; i < 3; ++i)
-	  //
-	  dm2[i] = tdm(perm[(i + 1) % 3], perm[(i + 2) % 3]);
-
-	btemp = false;
-	//
-	for(int i = 0; i < 3; ++i) {
-	  //
-	  if(!are_distances_equal(m1._dm[i], dm2[i])) {
-	    //
-	    btemp = true;
+      const double dtemp = vdistance(m1[rest], sc.pos[test]);
 	    
-	    break;
-	  }
-	}
-	
-	if(btemp)
-	  //
-	  continue;
-
-	// standard orientation
-	//
-	MolecGeom nm = m2;
-
-	nm -= m2[perm[0]];
-
-	nm *= D3::Matrix(nm[perm[1]], nm[perm[2]]);
-
-	/*
-	std::cout << "\n";
-	
-	for(int i = 0; i < 3; ++i)
-	  //
-	  std::cout << std::setw(3) << perm[i];
-	
-	std::cout << "\n";
-	  
-	for(int a = 0; a < m1.size(); ++a)
-	  //
-	  std::cout << m1[a] << "\n";
-	
-	std::cout << "\n";
-		
-	for(int a = 0; a < nm.size(); ++a)
-	  //
-	  std::cout << nm[a] << "\n";
-	
-	std::cout << "\n";
-		
-	*/
-	
-	// checking if the rest of the atoms coincide
+      if(match < 0 || dtemp < min_dist || (dtemp == min_dist && test < match)) {
 	//
-	for(int rest = 3; rest < m1.size(); ++rest) {
-	  //
-	  int    match = -1;
-	  
-	  double min_dist;
-  
-	  // best matching atom
-	  //
-	  for(int test = 0; test < nm.size(); ++test) {
-	    //
-	    btemp = false;
-	    
-	    for(int i = 0; i < perm.size(); ++i) {
-	      //
-	      if(test == perm[i]) {
-		//
-		btemp = true;
-		
-		break;
-	      }
-	    }
-	    
-	    if(btemp)
-	      //
-	      continue;
-	    
-	    if(m1[rest] != nm[test])
-	      //
-	      continue;
-	    
-	    dtemp = vdistance(m1[rest], nm[test]);
-	    
-	    if(match < 0 || dtemp < min_dist) {
-	      //
-	      min_dist = dtemp;
+	min_dist = dtemp;
 	      
-	      match = test;
-	    }
-	    //
-	  }// best matching atom
+	match = test;
+      }
+      //
+    }// best matching atom
  
-	  // different stoichiometry
-	  //
-	  if(match < 0) {
-	    //
-	    std::cerr << funame << "different stoichiometry\n";
-	    
-	    return 0;
-	  }
-
-	  // geometries differ
-	  //
-	  if(!are_distances_equal(min_dist, 0.)) {
-	    //
-	    //std::cout << "atom = " << rest << " best match = " << match << " distance = " << min_dist << "\n\n";
+    // geometries differ
+    //
+    if(match < 0 || !are_distances_equal(min_dist, 0.)) {
+      //
+      //std::cout << "atom = " << rest << " best match = " << match << " distance = " << min_dist << "\n\n";
 	    
-	    break;
-	  }
+      return false;
+    }
 	  
-	  perm.push_back(match);
-	  //
-	} // checking the rest of atoms
+    perm.push_back(match);
 
-	// geometries are identical
-	//
-	if(perm.size() == m1.size()) {
-	  //
-	  if(mode == MolecOrient::TEST) {
-	    //
-	    return 1;
-	  }
-	  else
-	    //
-	    ++result;
-	}
-	
-      }//
-      //
-    }//
+    sc.used[match] = frame;
     //
-  }// reference atoms cycle
-  
-  return result;
+  } // checking the rest of atoms
+
+  return true;
 }
 
-PrimStruct::PrimStruct (const MolecGeom& g, const std::set<std::set<int> >& ib)
-  //
-  : ConMat<unsigned>(g.size()), MolecGeom(g), _la(g.size(), false)
+// rotation-invariant signatures of all atoms; they are the same for the mirror image
+//
+const std::vector<AtomSignature>& MolecOrient::_signatures () const
 {
-  const char funame [] = "PrimStruct::PrimStruct(const MolecGeom&, const std::set<std::set<int> >&): ";
-
-  typedef std::vector<Atom>::iterator mit_t;
-  
-  // check that there are no dummies
-  //
-  for(mit_t at = std::vector<Atom>::begin(); at != std::vector<Atom>::end(); ++at)
-    //
-    if(*at == AtomBase::DUMMY) {
-      //
-      std::cerr << funame << "WARNING: dummy atom encountered - removing\n";
-      
-      at = std::vector<Atom>::erase(at);
-    }
-  
-  for(int i = 0; i < size(); ++i) {
+  if(_sig.size() != size()) {
     //
-    for(int j = 0; j < i; ++j) {
-      //
-      // bond
-      //
-      std::set<int> bond;
-
-      bond.insert(i);
-      bond.insert(j);
+    const MolecGeom& m = *this;
+    
+    _sig.clear();
+    
+    _sig.reserve(size());
 
-      if(vdistance(g[i], g[j]) < max_bond_length(g[i], g[j]) || ib.find(bond) != ib.end()) {
-	//
-	(*this)(i, j) = 1;
-      }
-      else {
-	//
-	(*this)(i, j) = 0;
-      }
-    }
+    for(int at = 0; at < size(); ++at)
+      //
+      _sig.push_back(AtomSignature(m, at));
   }
 
-  // check that the molecule is connected
-  //
-  //if(!is_connected())
-    //
-  //std::cerr << funame << "WARNING: bonding configuration is not connected\n";
+  return _sig;
+}
 
-  for(int i = 0; i < size(); ++i) {
-    //
-    // check that hydrogens are single bonded
+// the geometry or its mirror image in the xy plane of the standard orientation
+//
+const MolecGeom& MolecOrient::_geometry (bool mirror) const
+{
+  if(!mirror)
     //
-    if((*this)[i] == AtomBase::HYDROGEN && row_sum(i) > 1) {
-      //
-      std::cerr << funame << "WARNING: " << i << "-th hydrogen has more than one connection\n";
-    }
+    return *this;
 
-    // check the number of bonds
-    //
-    if(row_sum(i) > 4) {
-      //
-      std::cerr << funame << "WARNING: " << i << "-th atom has more than four connections\n";
-    }
-    
-    // check that oxygens have <= 2 connections
+  if(_image.size() != size()) {
     //
-    if((*this)[i] == AtomBase::OXYGEN && row_sum(i) > 2) {
-      //
-      std::cerr << funame << "WARNING: " << i << "-th oxygen has more than two connections\n";
-    }
-  }
+    _image = *this;
 
-  // check linearity
-  //
-  for(int at = 0; at < size(); ++at) {
-    //
-    // nearest neighbors
-    
-    std::vector<int> neighbor;
-    //
-    for(int at1 = 0; at1 < size(); ++at1) {
-      //
-      if(at1 != at && (*this)(at1, at))
-	//
-	neighbor.push_back(at1);
-    }
-    
-    if(neighbor.size() == 2 && are_angles_equal(180., angle(g[neighbor[0]], g[at], g[neighbor[1]]))) {
+    for(int at = 0; at < size(); ++at)
       //
-      _la[at] = true;
-
-      //std::cout << funame << at << "-the atom is linear\n";
-    }
+      _image[at][2] = -_image[at][2];
   }
+  
+  return _image;
 }
 
-// check if the structure is connected
+// spatial hash of the geometry (or its mirror image) atoms: the tested atom position is
+// transformed back to the geometry frame, and only the atoms in the neighboring cells are
+// checked; the cell size is slightly larger than the tolerance to cover the round-off of
+// the back transformation
 //
-bool PrimStruct::is_connected (int at, const std::list<int>& group) const
+const AtomGrid& MolecOrient::_atom_grid (bool mirror) const
 {
-  for(std::list<int>::const_iterator git = group.begin(); git != group.end(); ++git)
+  if(!_grid_done[mirror]) {
     //
-    if(at == *git || is_connected(at, *git))
-      //
-      return true;
+    _grid[mirror] = AtomGrid(_geometry(mirror), 1.01 * distance_tolerance);
 
-  return false;
+    _grid_done[mirror] = true;
+  }
+
+  return _grid[mirror];
 }
 
-std::list<std::list<int> > PrimStruct::connected_group () const
+// all matching reference frames of the nonlinear geometry (in the standard orientation)
+// and m2 or its mirror image; the matching atom permutations are appended to the pool
+// in the deterministic order
+//
+int MolecOrient::_frame_search (const MolecOrient& mo2, bool mirror, mode_t mode,
+				std::vector<std::vector<int> >* perm_pool) const
 {
-  int    itemp;
-  bool   btemp;
-  
-  std::list<std::list<int> > res;
+  const MolecGeom& m1 = *this;
+
+  const MolecGeom& m2 = mo2._geometry(mirror);
   
-  std::list<int> pool;
+  // reference atoms candidates pruned by rotation-invariant signatures:
   //
-  for(int i = 0; i < size(); ++i)
-    //
-    pool.push_back(i);
+  // distances from the first reference atom are preserved within the distance tolerance,
+  // those from the second one within the double tolerance; the third one is constrained
+  // by the reference atoms distance matrix only
+  //
+  std::vector<int> cand0, cand1;
+
+  const std::vector<AtomSignature>& sig1 = _signatures();
 
-  while(pool.size()) {
+  const std::vector<AtomSignature>& sig2 = mo2._signatures();
+  
+  for(int at = 0; at < m2.size(); ++at) {
     //
-    std::list<int> group;
+    if(m1[0] != m2[at] && m1[1] != m2[at])
+      //
+      continue;
+    
+    if(sig2[at].match(sig1[0], distance_tolerance))
+      //
+      cand0.push_back(at);
+
+    if(sig2[at].match(sig1[1], 2. * distance_tolerance))
+      //
+      cand1.push_back(at);
+  }
 
-    group.push_back(pool.back());
+  // spatial hash of m2 atoms in their own frame
+  //
+  const AtomGrid& grid = mo2._atom_grid(mirror);
 
-    pool.pop_back();
-    
-    btemp = true;
+  // per-worker scratch buffers
+  //
+  std::vector<FrameScratch> scratch(worker_count(cand0.size()), FrameScratch(m2.size()));
+
+  // number of matching frames for each first reference atom candidate
+  //
+  std::vector<int> count(cand0.size(), 0);
 
-    while(btemp) {
+  // matching permutations for each first reference atom candidate
+  //
+  std::vector<std::vector<std::vector<int> > > task_perm(perm_pool ? cand0.size() : 0);
+
+  // matching frame found in the test mode
+  //
+  std::atomic<bool> found(false);
+  
+  // three reference atoms cycle: the first reference atom candidates are distributed
+  // between the workers, and the result does not depend on the number of threads
+  //
+  parallel_for(cand0.size(), [&] (int task, int worker) {
       //
-      btemp = false;
+      int ref [3];
 
-      for(std::list<int>::iterator pit = pool.begin(); pit != pool.end(); ++pit) {
+      ref[0] = cand0[task];
+    
+      for(std::vector<int>::const_iterator c1 = cand1.begin(); c1 != cand1.end(); ++c1) {
 	//
-	if(is_connected(*pit, group)) {
+	ref[1] = *c1;
+      
+	if(ref[0] == ref[1])
 	  //
-	  btemp = true;
-	
-	  group.push_back(*pit);
+	  continue;
+      
+	for(ref[2] = 0; ref[2] < m2.size(); ++ref[2]) {
+	  //
+	  if(ref[2] == ref[1] || ref[2] == ref[0])
+	    //
+	    continue;
+
+	  if(mode == TEST && found)
+	    //
+	    return;
+
+	  if(!frame_match(m1, _dm, m2, grid, ref, scratch[worker]))
+	    //
+	    continue;
 	  
-	  pool.erase(pit);
+	  if(mode == TEST) {
+	    //
+	    found = true;
 
-	  break;
-	}
-      }
-    }
+	    return;
+	  }
 
-    res.push_back(group);
-  }
+	  ++count[task];
 
-  return res;
-}
+	  if(perm_pool)
+	    //
+	    task_perm[task].push_back(scratch[worker].perm);
+	}//
+	//
+      }//
+      //
+    });// reference atoms cycle
 
-// check if the bond belong to a ring structure
-//
-bool PrimStruct::is_ring (int at1, int at2) const 
-{
-  const char funame [] = "PrimStruct::is_ring: ";
+  if(mode == TEST)
+    //
+    return found ? 1 : 0;
 
-  if(at1 == at2) {
+  int result = 0;
+  
+  for(std::vector<int>::const_iterator cit = count.begin(); cit != count.end(); ++cit)
     //
-    std::cerr << funame << "the same atom: " << at1 << "\n";
+    result += *cit;
 
-    throw Error::General();
-  }
-
-  if(!is_connected(at1, at2)) {
+  if(perm_pool)
     //
-    std::cerr << funame << "not connected: " << at1 << ", " << at2 << "\n";
-			   
-    throw Error::General();
-  }
-
-						       
-  PrimStruct test = *this;
+    for(int task = 0; task < task_perm.size(); ++task)
+      //
+      perm_pool->insert(perm_pool->end(), task_perm[task].begin(), task_perm[task].end());
   
-  test(at1, at2) = 0;
-
-  return test.is_connected();
+  return result;
 }
 
-std::string PrimStruct::group_stoicheometry (const std::list<int>& group) const
-{
-  std::map<std::string, int> st;
 
-  for(std::list<int>::const_iterator git = group.begin(); git != group.end(); ++git)
-    //
-    ++st[atom_name(*git)];
+MolecOrient::MolecOrient (const MolecGeom& m)  : MolecGeom(m), _engine(GEOMETRIC), _index(m.size()), _ops_done(false), _iops_done(false), _perm_done(false)
+{
+  const char funame [] = "MolecOrient::MolecOrient (const MolecGeom&): ";
 
-  std::ostringstream res;
-  //
-  for(std::map<std::string, int>::const_iterator sit = st.begin(); sit != st.end(); ++sit)
-    //
-    res << sit->first << sit->second;
+  int    itemp;
+  
+  double dtemp;
+  
+  bool   btemp;
 
-  return res.str();
-}
+  int min_ind;
   
-/*
-// minimal number of bonds between two atoms
-//
-int  PrimStruct::distance (int at1, int at2) const 
-{
-  const char funame [] = "PrimStruct::distance: ";
+  double min_val;
+  bool istart;
 
-  if(size() < 2)
-    return 0;
-  if(at1 == at2)
-    return 0;
+  MolecGeom& m1 = *this;
 
-  std::vector<int> curr_set;
-  curr_set.reserve(size());
-  std::vector<int>  new_set;
-  new_set.reserve(size());
-  new_set.push_back(at1);
+  for(int i = 0; i < size(); ++i)
+    if(m1[i] == AtomBase::DUMMY) {
+      std::cout << funame << "no dummies, please\n";
+      throw Error::Range();
+    }
 
-  int dist = 0;
-  while(curr_set.size() != new_set.size()) {
-    ++dist;
-    curr_set = new_set;
-    new_set.clear();
-    for(int at = 0; at < size(); ++at)
-      for(int i = 0; i < curr_set.size(); ++i)
-	if(at == curr_set[i] || (*this)(at, curr_set[i])) {
-	  if(at == at2) {
-	    return dist;
-	  }
-	  new_set.push_back(at);
-	  break;
-	}
-  }
-  if(curr_set.size() != size()) {
-    std::cout << funame << "primary structure is not connected\n";
+  if(size() < 2 ) {
+    std::cout << funame << "wrong number of atoms\n";
     throw Error::Range();
   }
-  std::cout << funame << "at2, " << at2 << ", is out of range\n";
-  throw Error::Range();
-}
 
-*/
+  for(int i = 0; i < size(); ++i)
+    //
+    _index[i] = i;
 
-MolecStruct::MolecStruct (const PrimStruct& prim, const std::set<std::set<int> >& ib) 
-  : PrimStruct(prim)
-{
-  const char funame [] = "MolecStruct::MolecStruct(const PrimStruct&, const std::set<std::set<int> >&): ";
+  _grid_done[0] = _grid_done[1] = false;
+  
+  m1 -= m[0];
 
-  int    itemp;
-  double dtemp;
-  bool   btemp;
+  const double len0 = m1[1].vlength();
+  if(are_distances_equal(len0, 0.)) {
+    std::cout << funame << "atoms are too close\n";
+    throw Error::Range();
+  }
+
+  D3::Vector orth [2];
   
-  ConMat<unsigned> m = prim;
+  if(size() == 2) {// diatomic
+    _mt = LINEAR;
 
-  for(int i = 0; i < size(); ++i)
-    //
-    for(int j = 0; j < i; ++j)
-      //
-      if(m(i, j)) {
-	//
-	std::set<int> bond;
+    find_orth(m1[1], orth);
 
-	bond.insert(i);
-	
-	bond.insert(j);
+    _orient = D3::Matrix(m1[1], orth[0]);
 
-	if(ib.find(bond) == ib.end())
-	  //
-	  m(i, j) = 2;
-      }
+    for(int i = 0; i < 3; ++i)
+      if(!i)
+	m1[1][i] = len0;
+      else
+	m1[1][i] = 0.;
 
-  // checking if the primary structure is sound
-  //
-  if(!is_connected()) {
-    //
-    std::cout << funame << "primary structure is not connected\n";
-    
-    throw Error::Range();
+    _set_inertia();
+
+    return;
   }
 
-  for(int i = 0; i < size(); ++i) {
-    //
-    if(m.row_sum(i) > 2 * valence(i)) {
-      //
-      std::cout << funame << i << "-th " << atom_name(i) << " atom real valence exceeds its formal valence\n";
-      
-      throw Error::Range();
+  // is geometry linear?
+  istart = true;
+  for(int at = 2; at < size(); ++at) {
+    dtemp = std::fabs(90. - angle(m1[1], m1[0], m1[at]));
+    if(istart || dtemp < min_val) {
+      istart = false;
+      min_ind = at;
+      min_val = dtemp;
     }
   }
-  
-  // getting all bonding configurations (resonances)
-  //
-  _resonance.push_back(m);
 
-  // bond increment cycle
-  //
-  while(1) {
-    //
-    std::vector<ConMat<unsigned> > update;
+  /************************ Linear geometry ******************************/
+
+  if(are_angles_equal(min_val, 90.)) {// linear geometry
+    _mt = LINEAR;
+
+    // orient along x axis
+    D3::Vector n0 = m1[1];
+    n0 /= len0;
+
+    find_orth(n0, orth);
+
+    _orient = D3::Matrix(n0, orth[0]);
+
+    for(int at = 1; at < size(); ++at)
+      for(int i = 0; i < 3; ++i)
+	if(!i)
+	  m1[at][i] = vdot(m1[at], n0);
+	else
+	  m1[at][i] = 0.;
+
+    // sorting atoms
+    std::vector<double> coor(size());
+    for(int at = 0; at < size(); ++at)
+      coor[at] = m1[at][0];
+
+    std::vector<int> perm(size());
+    my_sort(coor, perm);
+
+    MolecGeom m(size());
     
-    for(int r = 0; r < _resonance.size(); ++r)
+    for(int at = 0; at < size(); ++at) {
       //
-      for(int i = 0; i < size(); ++i)
-	//
-	for(int j = 0; j < i; ++j)
-	  //
-	  if((*this)(i, j) && _resonance[r].row_sum(i) + 1 < 2 * valence(i) && _resonance[r].row_sum(j) + 1 < 2 * valence(j)) {
-	    //
-	    update.push_back(_resonance[r]);
-	    
-	    (*update.rbegin())(i, j) += 2;
-	  }
+      m[at] = m1[perm[at]];
+
+      _index[at] = perm[at];
+    }
     
-    // stop condition
-    //
-    if(!update.size())
-      //
-      break;
+    m1 = m;
 
-    // update resonance
-    //
-    _resonance.clear();
-    //
-    for(int r = 0; r < update.size(); ++r) {
-      //
-      bool btemp = true;
-      
-      for(int s = 0; s < _resonance.size(); ++s) {
-	//
-	if(_resonance[s] == update[r]) {
-	  //
-	  btemp = false;
-	  
-	  break;
-	}
-      }
-      
-      if(btemp)
-	//
-	_resonance.push_back(update[r]);
+    /*
+      std::cout << funame << "x-coordinates:";
+
+    for(int a = 0; a < size(); ++a)
       //
-    }//
-    //
-  }// bond increment cycle
+      std::cout << "   " << m1[a][0];
 
-  // first atom
-  //
-  _cpath.push_back(ConRec(0, -1));
+    std::cout << "\n";
+    */
+
+    _set_inertia();
+    
+    return;
+  }
+		
+  /************************* Nonlinear geometry **************************/
 
-  // atoms pool
+  // change atoms order
   //
-  std::vector<int> pool;
-  
-  for(int i = 1; i < size(); ++i)
+  if(min_ind != 2) {
     //
-    pool.push_back(i);
+    std::swap(m1[2], m1[min_ind]);
 
-  // reference (line #) of the previous connected atom
-  //
-  int cref = 0;
+    std::swap(_index[2], _index[min_ind]);
+  }
+
+  _orient = D3::Matrix(m1[1], m1[2]);
+  
+  m1 *= _orient; // standard orientation
 
-  // main cycle
+  // reference atoms distance matrix
   //
-  while(pool.size()) {
-    //
-    // beginning of the new group
+  for(int i = 0; i < 3; ++i)
     //
-    _cpath[cref].begin = _cpath.size();
+    _dm[i] = vdistance(m1[(i+1)%3], m1[(i+2)%3]);
 
-    // previous atom
+  // is molecule plane?
+  //
+  _mt = PLANE;
+
+  _set_inertia();
+  
+  if(size() == 3)
     //
-    const int prev = _cpath[cref].atom;
+    return;
 
-    if(is_linear(prev)) {
+  for(int a = 3; a < size(); ++a)
+    //
+    if(!are_distances_equal(m1[a][2], 0.)) {
       //
-      _cpath[cref].attr |= LIN_BOND;
+      _mt = NONLINEAR;
       
-      _cpath.push_back(ConRec(-1, cref));
+      break;
     }
+} 
+
+// center of mass, principal moments and axes of inertia, and the rotor type
+//
+void MolecOrient::_set_inertia ()
+{
+  const MolecGeom& m = *this;
+
+  double mass = 0.;
+  
+  _com = 0.;
 
-    // pool cycle
+  for(int a = 0; a < size(); ++a) {
     //
-    for(std::vector<int>::iterator poolit = pool.begin(); poolit != pool.end(); ) {
-      //
-      // current atom
-      //
-      const int curr = *poolit;
+    mass += m[a].mass();
 
-      //new record
-      //
-      if(is_connected(curr, prev)) {
-	//
-	ConRec crec(curr, cref);
-	
-	// beta bond attribute
-	//
-	BetaData beta = is_beta(curr, prev);
-	
-	if(beta) {
-	  //
-	  _betvar[_cpath.size()] = beta;
-	  
-	  crec.attr |= BET_BOND;
-	}
+    _com += m[a] * m[a].mass();
+  }
 
-	_cpath.push_back(crec);
-	
-	poolit = pool.erase(poolit);
-	//
-      } // new record
-      //
-      else {
-	//
-	++poolit;
-      }
-      //
-    } // pool cycle
-    
-    //
-    // end of the new group
-    //
-    _cpath[cref].end = _cpath.size();
+  _com /= mass;
 
-    while(_cpath[++cref].atom < 0) {}
+  D3::Matrix it;
+
+  for(int i = 0; i < 3; ++i)
     //
-  } // main cycle
+    for(int j = 0; j < 3; ++j)
+      //
+      it(i, j) = 0.;
 
-  // atom map
-  for(int i = 0; i < _cpath.size(); ++i) {
+  // moments of inertia degeneracy tolerance: if the atoms are displaced by dr, each
+  // principal moment changes by no more than 2 m r dr + m dr^2 per atom
+  //
+  _pm_tol = 0.;
+  
+  for(int a = 0; a < size(); ++a) {
     //
-    itemp = _cpath[i].atom;
+    const D3::Vector r = m[a] - _com;
+
+    const double r2 = r.vdot();
     
-    if(itemp >= 0)
+    for(int i = 0; i < 3; ++i)
       //
-      _atom_map[itemp] = i;
+      for(int j = 0; j < 3; ++j)
+	//
+	it(i, j) += m[a].mass() * ((i == j ? r2 : 0.) - r[i] * r[j]);
+
+    _pm_tol += 2. * m[a].mass() * (2. * std::sqrt(r2) * distance_tolerance + distance_tolerance * distance_tolerance);
   }
-    
-  /*
-  std::cout << "C_Path:\n"
-	    << std::setw(7) << "line #"
-	    << std::setw(7) << "atom"
-	    << std::setw(7) << "cref"
-	    << "\n";
+
+  diagonalize(it, _pm, _pa);
+
+  const bool deg01 = _pm[1] - _pm[0] < _pm_tol;
+
+  const bool deg12 = _pm[2] - _pm[1] < _pm_tol;
   
-  for(int i = 0; i < _cpath.size(); ++i)
-    std::cout << std::setw(7) << i
-	      << std::setw(7) << _cpath[i].atom
-	      << std::setw(7) << _cpath[i].cref
-	      << "\n";
-  */
-    
-  _coval.resize(2, 3, _cpath.size());
+  if(deg01 && deg12) {
+    //
+    _top = SPHERICAL_TOP;
+  }
+  else if(deg01 || deg12) {
+    //
+    _top = SYMMETRIC_TOP;
+  }
+  else
+    //
+    _top = ASYMMETRIC_TOP;
+}
+
+int  MolecOrient::sym_num () const 
+{
+  if(_mt == LINEAR)
+    //
+    return compare(*this, *this, SYMNUM);
   
-  int  lroot = -1;
+  if(_engine == GRAPH)
+    //
+    return _graph_sym_num();
 
-  bool lsingle;
+  return _proper_perm().size();
+}
 
-  std::ostringstream to;
+// the reference frames search of the nonlinear molecule with itself is done once: the asymmetric
+// top is searched near the principal axes rotations only
+//
+const std::vector<std::vector<int> >& MolecOrient::_proper_perm () const
+{
+  if(_perm_done)
+    //
+    return _perm;
+
+  _perm_done = true;
+
+  if(_top == ASYMMETRIC_TOP) {
+    //
+    _axes_search(&_perm);
+  }
+  else
+    //
+    _frame_search(*this, false, SYMNUM, &_perm);
+
+  return _perm;
+}
+
+// proper rotations of the asymmetric top: the only possible ones are the twofold rotations
+// around the principal axes; the images of the reference atoms are looked for near their
+// rotated positions, within the principal axis uncertainty, and each matching reference
+// frame is counted once, as in the full frame search, with the permutations appended
+// to the pool in the same order
+//
+int MolecOrient::_axes_search (std::vector<std::vector<int> >* perm_pool) const
+{
+  const MolecGeom& m = *this;
+
+  const AtomGrid& grid = _atom_grid(false);
+
+  FrameScratch sc(size());
+
+  // matching reference frames (images of the reference atoms) and their permutations
   //
-  to << std::left;
+  std::map<std::vector<int>, std::vector<int> > frame_pool;
   
-  // constructing z-matrix
+  std::vector<int> ref(3);
+
+  // identity
   //
-  for(int ref0 = 0; ref0 < _cpath.size(); ++ref0) {
+  for(int i = 0; i < 3; ++i)
     //
-    int ref1, ref2, ref3;
-    
-    // atom name
+    ref[i] = i;
+  
+  if(frame_match(*this, _dm, *this, grid, &ref[0], sc))
     //
-    if(_cpath[ref0].atom < 0) {
+    frame_pool[ref] = sc.perm;
+
+  // twofold rotations
+  //
+  std::vector<int> image [3];
+  
+  for(int k = 0; k < 3; ++k) {
+    //
+    D3::Vector axis;
+
+    for(int i = 0; i < 3; ++i)
       //
-      to << "X ";
-    }
-    else {
+      axis[i] = _pa(k, i);
+
+    // first order principal axis deviation angle
+    //
+    double gap = -1.;
+
+    for(int l = 0; l < 3; ++l)
       //
-      to << std::setw(2) << atom_name(_cpath[ref0].atom);
-    }
+      if(l != k && (gap < 0. || std::fabs(_pm[l] - _pm[k]) < gap))
+	//
+	gap = std::fabs(_pm[l] - _pm[k]);
+
+    const double angle = _pm_tol / gap;
     
-    // first reference (distance)
+    // images of the reference atoms
     //
-    if(ref0 > 0) {
+    for(int i = 0; i < 3; ++i) {
       //
-      ref1 = _cpath[ref0].cref;
+      D3::Vector r = m[i] - _com;
+
+      const double dist_max = 2. * (distance_tolerance + angle * r.vlength());
       
-      to << ", " << std::setw(2) << ref1 + 1 << ", " << var_name(DISTANCE) << std::setw(2) << ref0;
+      r = axis * (2. * vdot(axis, r)) - r;
 
-      if(_cpath[ref0].atom < 0) {
-	//
-	_coval(DISTANCE, ref0) = 1.;
+      r += _com;
 
-	_constvar.push_back(DISTANCE + 3 * ref0);
-      }
-      else {
+      image[i].clear();
+
+      for(int a = 0; a < size(); ++a)
 	//
-	_coval(DISTANCE, ref0) = ((*this)[_cpath[ref0].atom] - (*this)[_cpath[ref1].atom]).vlength();
-      }
+	if(m[a] == m[i] && vdistance(m[a], r) < dist_max)
+	  //
+	  image[i].push_back(a);
     }
 
-    // second reference (polar angle)
-    //
-    if(ref0 > 1) {
-      //
-      // ref1 linear
+    for(int i0 = 0; i0 < image[0].size(); ++i0)
       //
-      if(_cpath[ref1].attr & LIN_BOND) {
+      for(int i1 = 0; i1 < image[1].size(); ++i1)
 	//
-	// dummy atom
-	//
-	if(_cpath[ref0].atom < 0) {
+	for(int i2 = 0; i2 < image[2].size(); ++i2) {
 	  //
-	  ref2 = _cpath[ref1].cref;
+	  ref[0] = image[0][i0];
+	  ref[1] = image[1][i1];
+	  ref[2] = image[2][i2];
+	  
+	  if(ref[0] == ref[1] || ref[0] == ref[2] || ref[1] == ref[2] || frame_pool.find(ref) != frame_pool.end())
+	    //
+	    continue;
 
-	  _constvar.push_back(POLAR + 3 * ref0);
-	}
-	// real atom
-	//
-	else {
-	  //
-	  // dummy atom
-	  //
-	  ref2 = _cpath[ref1].begin;
+	  if(frame_match(*this, _dm, *this, grid, &ref[0], sc))
+	    //
+	    frame_pool[ref] = sc.perm;
 	}
-	
-	_coval(POLAR, ref0) = 90.;
-      }
+  }
+
+  if(perm_pool)
+    //
+    for(std::map<std::vector<int>, std::vector<int> >::const_iterator fit = frame_pool.begin(); fit != frame_pool.end(); ++fit)
       //
-      // ref1 nonlinear
+      perm_pool->push_back(fit->second);
+  
+  return frame_pool.size();
+}
+
+// symmetry number from the bonded graph automorphisms: colour refinement splits the atoms
+// into graph-equivalence classes, the images of the three reference atoms are taken from
+// their classes with the bonding preserved, and each such partial automorphism fixes one
+// proper rotation, which forces the images of the remaining atoms
+//
+int MolecOrient::_graph_sym_num () const
+{
+  const MolecGeom& m = *this;
+
+  const int n = size();
+
+  // bonded graph of the primary structure
+  //
+  const PrimStruct bond(m, std::set<std::set<int> >());
+
+  const ConList& adj = bond.adjacency();
+
+  // colour refinement
+  //
+  std::vector<int> color(n);
+
+  int ncolor;
+  
+  {
+    std::map<std::pair<int, int>, int> cmap;
+    
+    for(int i = 0; i < n; ++i)
       //
-      else {
-	//
-	// root atom
-	//
-	if(!ref1) {
-	  //
-	  ref2 = 1;
-	}
+      color[i] = cmap.insert(std::make_pair(std::make_pair((int)m[i].number(), m[i].isotope()), (int)cmap.size())).first->second;
+
+    ncolor = cmap.size();
+  }
+
+  while(1) {
+    //
+    std::map<std::vector<int>, int> cmap;
+
+    std::vector<int> new_color(n);
+    
+    for(int i = 0; i < n; ++i) {
+      //
+      std::vector<int> key(1, color[i]);
+
+      for(const int* j = adj.begin(i); j != adj.end(i); ++j)
 	//
-	else {
-	  //
-	  ref2 = _cpath[ref1].cref;
-	}
+	key.push_back(color[*j]);
 
-	_coval(POLAR, ref0) = angle((*this)[_cpath[ref0].atom],
-					  (*this)[_cpath[ref1].atom],
-					  (*this)[_cpath[ref2].atom]);
-      }
-      
-      to << ", " << std::setw(2) << ref2 + 1 << ", " << var_name(POLAR) << std::setw(2) << ref0;
+      std::sort(key.begin() + 1, key.end());
+
+      new_color[i] = cmap.insert(std::make_pair(key, (int)cmap.size())).first->second;
     }
 
-    // third reference (dihedral angle)
-    //
-    if(ref0 > 2) {
+    color = new_color;
+    
+    if(cmap.size() == ncolor)
       //
-      // ref1 linear
+      break;
+
+    ncolor = cmap.size();
+  }
+
+  // graph-equivalence classes
+  //
+  std::vector<std::vector<int> > cls(ncolor);
+
+  for(int i = 0; i < n; ++i)
+    //
+    cls[color[i]].push_back(i);
+
+  // reference atoms images cycle
+  //
+  int result = 0;
+
+  std::vector<int> perm(n), used(n, -1);
+
+  int stamp = 0;
+  
+  for(std::vector<int>::const_iterator a0 = cls[color[0]].begin(); a0 != cls[color[0]].end(); ++a0) {
+    //
+    for(std::vector<int>::const_iterator a1 = cls[color[1]].begin(); a1 != cls[color[1]].end(); ++a1) {
       //
-      if(_cpath[ref1].attr & LIN_BOND) {
+      if(*a1 == *a0 || bond(0, 1) != bond(*a0, *a1) || !are_distances_equal(_dm[2], vdistance(m[*a0], m[*a1])))
 	//
-	// dummy atom
+	continue;
+
+      for(std::vector<int>::const_iterator a2 = cls[color[2]].begin(); a2 != cls[color[2]].end(); ++a2) {
 	//
-	if(_cpath[ref0].atom < 0) {
+	if(*a2 == *a0 || *a2 == *a1 || bond(0, 2) != bond(*a0, *a2) || bond(1, 2) != bond(*a1, *a2)
+	   //
+	   || !are_distances_equal(_dm[1], vdistance(m[*a0], m[*a2]))
+	   //
+	   || !are_distances_equal(_dm[0], vdistance(m[*a1], m[*a2])))
 	  //
-	  if(_cpath[ref2].attr & LIN_BOND) {
-	    //
-	    // ref2 dummy atom
-	    //
-	    ref3 = _cpath[ref2].begin;
-	  }
-	  else if(ref2) {
-	    //
-	    ref3 = _cpath[ref2].cref;
-	  }
-	  else if(ref1 == 1) {
-	    //
-	    ref3 = 2;
-	  }
-	  else {
-	    //
- 	    ref3 = 1;
-	  }	  
-
-	  _coval(DIHEDRAL, ref0) = 0.;
+	  continue;
 
-	  _constvar.push_back(DIHEDRAL + 3 * ref0);
-	}
-	//
-	// real atom
+	// proper rotation to the standard orientation of the reference atoms images
 	//
-	else {
+	const D3::Matrix rot(m[*a1] - m[*a0], m[*a2] - m[*a0]);
+
+	++stamp;
+	
+	perm[0] = *a0;
+	perm[1] = *a1;
+	perm[2] = *a2;
+
+	for(int i = 0; i < 3; ++i)
 	  //
-	  // ref1 is root
+	  used[perm[i]] = stamp;
+
+	// images of the rest of the atoms
+	//
+	bool isok = true;
+	
+	for(int i = 3; i < n; ++i) {
 	  //
-	  if(!ref1) {
+	  int    match = -1;
+
+	  double min_dist;
+
+	  for(std::vector<int>::const_iterator j = cls[color[i]].begin(); j != cls[color[i]].end(); ++j) {
 	    //
-	    ref3 = 2;
-	  }
-	  else {
-	    //
-	    ref3 = _cpath[ref1].cref;
-	  }	 
+	    if(used[*j] == stamp)
+	      //
+	      continue;
 
-	  _coval(DIHEDRAL, ref0) = 180.;
-	}
-      }
-      //
-      // ref1 nonlinear
-      //
-      else {
-	//
-	bool islin = false;
+	    D3::Vector v = m[*j];
 
-	bool isring = is_ring(_cpath[ref1].atom, _cpath[ref2].atom);
-	
-	bool isingle = is_single(_cpath[ref1].atom, _cpath[ref2].atom);
+	    v -= m[*a0];
 
-	//std::cout << "atoms: " << _cpath[ref1].atom << ", " << _cpath[ref2].atom << ": is ring? " << isring << std::endl;
-	
-	bool isrot = !isring && isingle;
+	    v *= rot;
 
-	// not the first atom in the group
-	//
-	if(ref0 != _cpath[ref1].begin) {
-	  //
-	  if(!ref1) {
-	    //
-	    ref3 = 2;
+	    const double dtemp = vdistance(m[i], v);
+
+	    if(match < 0 || dtemp < min_dist) {
+	      //
+	      min_dist = dtemp;
+
+	      match = *j;
+	    }
 	  }
-	  else {
+
+	  if(match < 0 || !are_distances_equal(min_dist, 0.)) {
 	    //
-	    ref3 = _cpath[ref1].begin;
+	    isok = false;
+
+	    break;
 	  }
 
-	  isrot = false;
+	  perm[i] = match;
+
+	  used[match] = stamp;
 	}
-	// ref2 is linear
+
+	if(!isok)
+	  //
+	  continue;
+
+	// the permutation should be a graph automorphism
 	//
-	else if(_cpath[ref2].attr & LIN_BOND) {
+	for(int i = 0; i < n && isok; ++i)
 	  //
-	  islin = true;
-	  
-	  // ref2 dummy atom as dihedral reference ref3
+	  for(const int* j = adj.begin(i); j != adj.end(i) && *j < i; ++j)
+	    //
+	    if(!bond(perm[i], perm[*j])) {
+	      //
+	      isok = false;
+
+	      break;
+	    }
+
+	if(isok)
 	  //
-	  ref3 = _cpath[ref2].begin;
-	  
-	  int curr = ref2;
+	  ++result;
+      }
+    }
+  }
 
-	  int prev = ref1;
+  return result;
+}
 
-	  while(curr && _cpath[curr].attr & LIN_BOND) {
-	    //
-	    if(is_single(_cpath[curr].atom, _cpath[prev].atom))
-	      //
-	      isingle = true;
+bool MolecOrient::is_enantiomer () const 
+{
+  if(_mt == NONLINEAR) {
+    //
+    if(_iops_done)
+      //
+      return _iops.empty();
 
-	    prev = curr;
+    // the mirror image shares the atom signatures with the geometry
+    //
+    return !_frame_search(*this, true, TEST);
+  }
+  
+  return false;
+}
 
-	    curr = _cpath[curr].cref;
-	  }
-	  
-	  isrot = !isring && isingle;
+int MolecOrient::SymOp::order () const
+{
+  double dtemp = 0.;
 
-	  // nonlinear non-root atom
-	  //
-	  if(curr) {
-	    //
-	    curr = _cpath[curr].cref;
+  for(int i = 0; i < 3; ++i)
+    //
+    dtemp += rot(i, i);
 
-	    _coval(DIHEDRAL, ref0) = angle((*this)[_cpath[ref0].atom], 
-						 (*this)[_cpath[ref1].atom],
-						 (*this)[_cpath[ref2].atom], 
-						 (*this)[_cpath[curr].atom]);
-	  }
-	  //
-	  // root atom
-	  //
-	  else {
-	    //
-	    // linear root
-	    //
-	    if(_cpath[curr].attr & LIN_BOND) {
-	      //
-	      // first approach to the linear root
-	      //
-	      if(lroot < 0) {
-		//
-		lroot = _cpath[ref0].atom;
+  // rotation angle cosine
+  //
+  dtemp = proper ? (dtemp - 1.) / 2. : (dtemp + 1.) / 2.;
 
-		lsingle = isingle;
+  if(dtemp > 1.)
+    //
+    dtemp = 1.;
 
-		_coval(DIHEDRAL, ref0) = 0.;
+  if(dtemp < -1.)
+    //
+    dtemp = -1.;
 
-		_constvar.push_back(DIHEDRAL + 3 * ref0);
+  dtemp = std::acos(dtemp);
 
-		isrot = false;
-	      }
-	      // second approach to the linear root
-	      //
-	      else {
-		//
-		_coval(DIHEDRAL, ref0) = angle((*this)[_cpath[ref0].atom],
-						     (*this)[_cpath[ref1].atom],
-						     (*this)[_cpath[ref2].atom],
-						     (*this)[lroot]);
+  if(dtemp < 1.e-3)
+    //
+    return 1;
 
-		isrot = !isring && (isingle || lsingle);
-	      }
-	    }
-	    // nonlinear root
-	    //
-	    else {
-	      //
-	      // terminal root
-	      //
-	      if(row_sum(0) == 1) {
-		//
-		_coval(DIHEDRAL, ref0) = 0.;
+  return (int)std::floor(2. * M_PI / dtemp + 0.5);
+}
 
-		_constvar.push_back(DIHEDRAL + 3 * ref0);
+// symmetry operation from the oriented atoms permutation and the linear transformation
+// of the standard orientation coordinates (column vector convention)
+//
+MolecOrient::SymOp MolecOrient::_sym_op (const std::vector<int>& perm, const D3::Matrix& op, bool proper) const
+{
+  SymOp res;
 
-		isrot = false;
-	      }
-	      // root with several bonds
-	      //
-	      else if(prev == 1) {
-		//
-		_coval(DIHEDRAL, ref0) = angle((*this)[_cpath[ref0].atom], 
-					       (*this)[_cpath[ref1].atom],
-					       (*this)[_cpath[ref2].atom], 
-					       (*this)[_cpath[2   ].atom]);
-	      }
-	      else {
-		//
-		_coval(DIHEDRAL, ref0) = angle((*this)[_cpath[ref0].atom],
-					       (*this)[_cpath[ref1].atom],
-					       (*this)[_cpath[ref2].atom],
-					       (*this)[_cpath[1   ].atom]);
-	      }
-	    }
-	  }
-	  //
-	  //
-	} // ref2 is linear
+  res.proper = proper;
+  
+  res.perm.resize(size());
+
+  for(int a = 0; a < size(); ++a)
+    //
+    res.perm[_index[a]] = _index[perm[a]];
+
+  // to the input geometry frame
+  //
+  for(int i = 0; i < 3; ++i)
+    //
+    for(int j = 0; j < 3; ++j) {
+      //
+      double dtemp = 0.;
+      
+      for(int k = 0; k < 3; ++k)
 	//
-	else if(ref2) {
-	  //
-	  ref3 = _cpath[ref2].cref;
-	}
-	else if(ref1 == 1) {
-	  //
-	  ref3 = 2;
-	}
-	else {
+	for(int l = 0; l < 3; ++l)
 	  //
-	  ref3 = 1;
-	}
+	  dtemp += _orient(k, i) * op(k, l) * _orient(l, j);
 
-	if(!islin) {
-	  //
-	  _coval(DIHEDRAL, ref0) = angle((*this)[_cpath[ref0].atom], 
-					       (*this)[_cpath[ref1].atom],
-					       (*this)[_cpath[ref2].atom], 
-					       (*this)[_cpath[ref3].atom]);
-	}
+      res.rot(i, j) = dtemp;
+    }
 
-	if(isrot) {
-	  //
-	  PrimStruct test = *this;
+  return res;
+}
 
-	  test(_cpath[ref1].atom, _cpath[ref2].atom) = 0;
-	  
-	  _rotvar[ref0] = test.connected_group();
+// the standard orientation frame of the permutation image: the rotation which moves
+// m1 onto m2 is its transpose (see frame_match)
+//
+D3::Matrix image_frame (const MolecGeom& m2, const std::vector<int>& perm)
+{
+  return D3::Matrix(m2[perm[1]] - m2[perm[0]], m2[perm[2]] - m2[perm[0]]);
+}
 
-	  itemp = _rotvar[ref0].size();
-	  
-	  if(itemp != 2) {
-	    //
-	    std::cerr << funame << "wrong number of rotational groups: " << itemp << "\n";
-	    
-	    throw Error::General();
-	  }
-	  
-	  for(std::list<std::list<int> >::iterator git = _rotvar[ref0].begin(); git != _rotvar[ref0].end(); ++git) {
-	    //
-	    for(std::list<int>::iterator it = git->begin(); it != git->end(); ++it)
-	      //
-	      if(*it == _cpath[ref1].atom || *it == _cpath[ref2].atom) {
-		//
-		itemp = *it;
-		
-		git->erase(it);
-		
-		git->push_front(itemp);
-		
-		break;
-	      }
-	  }
-	}
-	//
-	//
-      } // ref1 is nonlinear
-      
-      to << ", " << std::setw(2) << ref3 + 1 << ", " << var_name(DIHEDRAL) << std::setw(2) << ref0;
+D3::Matrix diagonal_matrix (double x, double y, double z)
+{
+  D3::Matrix res;
+
+  for(int i = 0; i < 3; ++i)
+    //
+    for(int j = 0; j < 3; ++j)
+      //
+      res(i, j) = 0.;
+
+  res(0, 0) = x;
+  res(1, 1) = y;
+  res(2, 2) = z;
+
+  return res;
+}
+
+const std::vector<MolecOrient::SymOp>& MolecOrient::sym_ops () const
+{
+  if(_ops_done)
+    //
+    return _ops;
+
+  _ops_done = true;
+
+  const int n = size();
+  
+  std::vector<int> perm(n);
+
+  // identity
+  //
+  for(int a = 0; a < n; ++a)
+    //
+    perm[a] = a;
+
+  _ops.push_back(_sym_op(perm, diagonal_matrix(1., 1., 1.), true));
+
+  // linear molecule: twofold rotation perpendicular to the molecular axis
+  //
+  if(_mt == LINEAR) {
+    //
+    if(compare(*this, *this, SYMNUM) > 1) {
       //
+      for(int a = 0; a < n; ++a)
+	//
+	perm[a] = n - a - 1;
+
+      _ops.push_back(_sym_op(perm, diagonal_matrix(-1., 1., -1.), true));
+    }
+    
+    return _ops;
+  }
+
+  const MolecGeom& m = *this;
+  
+  const std::vector<std::vector<int> >& perm_pool = _proper_perm();
+
+  for(std::vector<std::vector<int> >::const_iterator pit = perm_pool.begin(); pit != perm_pool.end(); ++pit) {
+    //
+    const D3::Matrix frame = image_frame(m, *pit);
+
+    D3::Matrix op;
+    
+    for(int i = 0; i < 3; ++i)
       //
-    } // dihedral angle value and reference
+      for(int j = 0; j < 3; ++j)
+	//
+	op(i, j) = frame(j, i);
 
-    to << "\n";
+    // identity is already there
+    //
+    if(*pit != perm)
+      //
+      _ops.push_back(_sym_op(*pit, op, true));
   }
   
-  _zmat = to.str();
+  return _ops;
 }
 
-// atom-to-zmatrix map
+// rotation-reflections are the proper rotations matching the molecule with its mirror
+// image in the xy plane of the standard orientation
 //
-int MolecStruct::atom_map (int i) const
+const std::vector<MolecOrient::SymOp>& MolecOrient::improper_ops () const
 {
-  std::map<int, int>::const_iterator it = _atom_map.find(i);
-  
-  if(it != _atom_map.end())
+  if(_iops_done)
     //
-    return it->second;
+    return _iops;
+
+  _iops_done = true;
+
+  const int n = size();
   
-  return -1;
+  std::vector<int> perm(n);
+
+  // linear molecule: reflection in a plane containing the molecular axis,
+  // inversion, and reflection in the perpendicular plane
+  //
+  if(_mt == LINEAR) {
+    //
+    for(int a = 0; a < n; ++a)
+      //
+      perm[a] = a;
+
+    _iops.push_back(_sym_op(perm, diagonal_matrix(1., 1., -1.), false));
+
+    if(compare(*this, *this, SYMNUM) > 1) {
+      //
+      for(int a = 0; a < n; ++a)
+	//
+	perm[a] = n - a - 1;
+
+      _iops.push_back(_sym_op(perm, diagonal_matrix(-1., -1., -1.), false));
+
+      _iops.push_back(_sym_op(perm, diagonal_matrix(-1., 1., 1.), false));
+    }
+    
+    return _iops;
+  }
+
+  const MolecGeom& image = _geometry(true);
+
+  std::vector<std::vector<int> > perm_pool;
+
+  _frame_search(*this, true, SYMNUM, &perm_pool);
+
+  for(std::vector<std::vector<int> >::const_iterator pit = perm_pool.begin(); pit != perm_pool.end(); ++pit) {
+    //
+    const D3::Matrix frame = image_frame(image, *pit);
+
+    D3::Matrix op;
+    
+    for(int i = 0; i < 3; ++i)
+      //
+      for(int j = 0; j < 3; ++j)
+	//
+	op(i, j) = i == 2 ? -frame(j, i) : frame(j, i);
+
+    _iops.push_back(_sym_op(*pit, op, false));
+  }
+  
+  return _iops;
+}
+
+std::string MolecOrient::point_group () const
+{
+  const char funame [] = "MolecOrient::point_group: ";
+  
+  const std::vector<SymOp>& ops  = sym_ops();
+  const std::vector<SymOp>& iops = improper_ops();
+
+  int reflection_count = 0;
+
+  bool has_inversion = false;
+  
+  for(std::vector<SymOp>::const_iterator it = iops.begin(); it != iops.end(); ++it)
+    //
+    switch(it->order()) {
+      //
+    case 1:
+      //
+      ++reflection_count;
+
+      break;
+
+    case 2:
+      //
+      has_inversion = true;
+    }
+  
+  if(_mt == LINEAR)
+    //
+    return has_inversion ? "Dinfh" : "Cinfv";
+
+  int n = 1;
+
+  for(std::vector<SymOp>::const_iterator it = ops.begin(); it != ops.end(); ++it)
+    //
+    n = std::max(n, it->order());
+
+  std::ostringstream res;
+  
+  // cubic groups
+  //
+  if(ops.size() == 12 && n == 3) {
+    //
+    res << "T";
+
+    if(reflection_count == 6)
+      //
+      res << "d";
+    else if(iops.size())
+      //
+      res << "h";
+  }
+  else if(ops.size() == 24 && n == 4) {
+    //
+    res << "O";
+
+    if(iops.size())
+      //
+      res << "h";
+  }
+  else if(ops.size() == 60 && n == 5) {
+    //
+    res << "I";
+
+    if(iops.size())
+      //
+      res << "h";
+  }
+  // cyclic groups
+  //
+  else if(ops.size() == n) {
+    //
+    if(!iops.size())
+      //
+      res << "C" << n;
+    else if(n == 1)
+      //
+      res << (reflection_count ? "Cs" : "Ci");
+    else if(reflection_count == n)
+      //
+      res << "C" << n << "v";
+    else if(reflection_count)
+      //
+      res << "C" << n << "h";
+    else
+      //
+      res << "S" << 2 * n;
+  }
+  // dihedral groups
+  //
+  else if(ops.size() == 2 * n) {
+    //
+    res << "D" << n;
+
+    if(reflection_count > n)
+      //
+      res << "h";
+    else if(iops.size())
+      //
+      res << "d";
+  }
+  else {
+    //
+    std::cerr << funame << "inconsistent symmetry operations: " << ops.size() << " rotations, the highest order = " << n << "\n";
+
+    throw Error::Range();
+  }
+
+  return res.str();
+}
+
+int compare (const MolecOrient& m1, const MolecOrient& m2, 
+	     MolecOrient::mode_t mode) 
+{
+  const char funame [] = "MolecOrient::compare: ";
+
+  int    itemp;
+  double dtemp;
+  bool   btemp;
+
+  if(m1.size() < 2 || m2.size() < 2) {
+    //
+    std::cerr << funame << "wrong number of atoms\n";
+    
+    throw Error::Range();
+  }
+
+  if(m1.size() != m2.size())
+    //
+    return 0;
+    
+  if(m1._mt != m2._mt)
+    //
+    return 0;
+
+  int result = 0;
+
+  /************************ Linear geometry ************************/
+
+  if(m1._mt == MolecOrient::LINEAR) {
+    //
+    btemp = true;
+    
+    for(int at = 1; at < m1.size(); ++at)
+      //
+      if(m1[at] != m2[at] || !are_distances_equal(m1[at][0] - m1[0][0], m2[at][0] - m2[0][0])) {
+	//
+	btemp = false;
+
+	break;
+      }
+    
+    if(btemp) {
+      //
+      ++result;
+      
+      if(mode == MolecOrient::TEST)
+	//
+	return 1;
+    }
+
+    btemp = true;
+    
+    for(int at = 1; at < m1.size(); ++at)
+      //
+      if(m1[at] != m2[m1.size() - at - 1] || !are_distances_equal(m1[at][0] - m1[0][0], m2[m1.size() - 1][0] - m2[m1.size() - at - 1][0])) {
+	//
+	btemp = false;
+	
+	break;
+      }
+    
+    if(btemp)
+      //
+      ++result;
+
+    return result;
+  }
+    
+  /************************ Nonlinear geometry ************************/
+
+  // stoichiometry
+  //
+  std::map<AtomBase, int> st;
+
+  for(int at = 0; at < m1.size(); ++at)
+    //
+    ++st[m1[at]];
+
+  for(int at = 0; at < m2.size(); ++at)
+    //
+    if(--st[m2[at]] < 0) {
+      //
+      std::cerr << funame << "different stoichiometry\n";
+      
+      return 0;
+    }
+  
+  return m1._frame_search(m2, false, mode);
+}
+
+PrimStruct::PrimStruct (const MolecGeom& g, const std::set<std::set<int> >& ib)
+  //
+  : ConMat<bool>(g.size()), MolecGeom(g), _la(g.size(), false), _adj_done(false),
+    _group_done(false), _bridge(g.size()), _bridge_done(false)
+{
+  const char funame [] = "PrimStruct::PrimStruct(const MolecGeom&, const std::set<std::set<int> >&): ";
+
+  typedef std::vector<Atom>::iterator mit_t;
+  
+  // check that there are no dummies
+  //
+  for(mit_t at = std::vector<Atom>::begin(); at != std::vector<Atom>::end(); ++at)
+    //
+    if(*at == AtomBase::DUMMY) {
+      //
+      std::cerr << funame << "WARNING: dummy atom encountered - removing\n";
+      
+      at = std::vector<Atom>::erase(at);
+    }
+  
+  // bonded atoms
+  //
+  std::vector<std::vector<int> > neighbor(size());
+
+  // cell list with the cell size equal to the largest bond length: all bonded atoms are
+  // in the neighboring cells
+  //
+  std::set<AtomBase> atom_type;
+  
+  for(int i = 0; i < size(); ++i)
+    //
+    atom_type.insert(g[i]);
+
+  double cell = 0.;
+
+  for(std::set<AtomBase>::const_iterator t1 = atom_type.begin(); t1 != atom_type.end(); ++t1)
+    //
+    for(std::set<AtomBase>::const_iterator t2 = t1; t2 != atom_type.end(); ++t2)
+      //
+      cell = std::max(cell, max_bond_length(*t1, *t2));
+
+  if(size()) {
+    //
+    const AtomGrid grid(g, cell, false);
+
+    std::vector<int> near;
+
+    for(int i = 0; i < size(); ++i) {
+      //
+      grid.find(g[i], near);
+
+      for(std::vector<int>::const_iterator nit = near.begin(); nit != near.end(); ++nit) {
+	//
+	const int j = *nit;
+
+	if(j < i && vdistance(g[i], g[j]) < max_bond_length(g[i], g[j])) {
+	  //
+	  (*this)(i, j) = 1;
+
+	  neighbor[i].push_back(j);
+
+	  neighbor[j].push_back(i);
+	}
+      }
+    }
+  }
+
+  // incipient bonds merged from the flat pair list
+  //
+  std::vector<std::pair<int, int> > ib_pair;
+
+  for(std::set<std::set<int> >::const_iterator bit = ib.begin(); bit != ib.end(); ++bit)
+    //
+    if(bit->size() == 2)
+      //
+      ib_pair.push_back(std::make_pair(*bit->begin(), *bit->rbegin()));
+
+  for(std::vector<std::pair<int, int> >::const_iterator pit = ib_pair.begin(); pit != ib_pair.end(); ++pit) {
+    //
+    const int i = pit->first;
+
+    const int j = pit->second;
+
+    if(i < 0 || j >= size() || (*this)(i, j))
+      //
+      continue;
+
+    (*this)(i, j) = 1;
+
+    neighbor[i].push_back(j);
+
+    neighbor[j].push_back(i);
+  }
+
+  _adj = ConList(neighbor);
+
+  _adj_done = true;
+  
+  // check that the molecule is connected
+  //
+  //if(!is_connected())
+    //
+  //std::cerr << funame << "WARNING: bonding configuration is not connected\n";
+
+  for(int i = 0; i < size(); ++i) {
+    //
+    // check that hydrogens are single bonded
+    //
+    if((*this)[i] == AtomBase::HYDROGEN && _adj.degree(i) > 1) {
+      //
+      std::cerr << funame << "WARNING: " << i << "-th hydrogen has more than one connection\n";
+    }
+
+    // check the number of bonds
+    //
+    if(_adj.degree(i) > 4) {
+      //
+      std::cerr << funame << "WARNING: " << i << "-th atom has more than four connections\n";
+    }
+    
+    // check that oxygens have <= 2 connections
+    //
+    if((*this)[i] == AtomBase::OXYGEN && _adj.degree(i) > 2) {
+      //
+      std::cerr << funame << "WARNING: " << i << "-th oxygen has more than two connections\n";
+    }
+  }
+
+  // check linearity
+  //
+  for(int at = 0; at < size(); ++at) {
+    //
+    // nearest neighbors
+    //
+    const int* nit = _adj.begin(at);
+    
+    if(_adj.degree(at) == 2 && are_angles_equal(180., angle(g[nit[0]], g[at], g[nit[1]]))) {
+      //
+      _la[at] = true;
+
+      //std::cout << funame << at << "-the atom is linear\n";
+    }
+  }
+}
+
+// check if the structure is connected
+//
+bool PrimStruct::is_connected (int at, const std::list<int>& group) const
+{
+  for(std::list<int>::const_iterator git = group.begin(); git != group.end(); ++git)
+    //
+    if(at == *git || is_connected(at, *git))
+      //
+      return true;
+
+  return false;
+}
+
+const ConList& PrimStruct::adjacency () const
+{
+  if(!_adj_done) {
+    //
+    _adj = ConList((const ConMat<bool>&)*this);
+
+    _adj_done = true;
+  }
+
+  return _adj;
+}
+
+// connected groups: each group is seeded by the largest remaining atom index, and the
+// lowest index atom bonded to the group is added next; the bond between skip0 and skip1
+// atoms, if any, is ignored
+//
+void PrimStruct::_frontier_group (std::list<std::list<int> >& res, int skip0, int skip1) const
+{
+  res.clear();
+  
+  const ConList& neighbor = adjacency();
+
+  // atoms which are already in the group or bonded to it
+  //
+  std::vector<bool> reached(size(), false);
+  
+  for(int seed = size() - 1; seed >= 0; --seed) {
+    //
+    if(reached[seed])
+      //
+      continue;
+
+    res.push_back(std::list<int>());
+
+    std::list<int>& group = res.back();
+
+    // atoms bonded to the group
+    //
+    std::priority_queue<int, std::vector<int>, std::greater<int> > front;
+
+    reached[seed] = true;
+
+    front.push(seed);
+
+    while(front.size()) {
+      //
+      const int at = front.top();
+
+      front.pop();
+
+      group.push_back(at);
+
+      for(const int* nit = neighbor.begin(at); nit != neighbor.end(at); ++nit)
+	//
+	if(!reached[*nit] && !((at == skip0 && *nit == skip1) || (at == skip1 && *nit == skip0))) {
+	  //
+	  reached[*nit] = true;
+
+	  front.push(*nit);
+	}
+    }
+  }
+}
+
+const std::list<std::list<int> >& PrimStruct::connected_group () const
+{
+  if(!_group_done) {
+    //
+    _frontier_group(_group);
+
+    _group_done = true;
+  }
+
+  return _group;
+}
+
+// two groups the connected structure splits into without the bridge bond, in the
+// connected_group order
+//
+std::list<std::list<int> > PrimStruct::bridge_group (int at0, int at1) const
+{
+  const char funame [] = "PrimStruct::bridge_group: ";
+
+  if(!is_connected(at0, at1) || is_ring(at0, at1) || !is_connected()) {
+    //
+    std::cerr << funame << "not a bridge: " << at0 << ", " << at1 << "\n";
+
+    throw Error::General();
+  }
+
+  std::list<std::list<int> > res;
+
+  _frontier_group(res, at0, at1);
+
+  return res;
+}
+
+// bridges, i.e. the bonds whose removal splits the structure: depth-first search
+// with the low-link numbers (Tarjan), without recursion
+//
+void PrimStruct::_set_bridge () const
+{
+  _bridge_done = true;
+
+  _bridge = ConMat<bool>(size());
+
+  const ConList& neighbor = adjacency();
+
+  std::vector<int> order(size(), -1); // discovery order
+
+  std::vector<int> low(size()); // lowest discovery order reachable from the subtree
+
+  // depth-first search stack: atom, its parent, and the next neighbor to visit
+  //
+  struct Frame { int atom; int parent; int next; };
+
+  std::vector<Frame> stack;
+
+  int count = 0;
+  
+  for(int root = 0; root < size(); ++root) {
+    //
+    if(order[root] >= 0)
+      //
+      continue;
+
+    order[root] = low[root] = count++;
+
+    Frame f = {root, -1, 0};
+    
+    stack.push_back(f);
+
+    while(stack.size()) {
+      //
+      Frame& top = stack.back();
+
+      const int at = top.atom;
+      
+      if(top.next < neighbor.degree(at)) {
+	//
+	const int next = neighbor.begin(at)[top.next++];
+
+	if(next == top.parent)
+	  //
+	  continue;
+
+	if(order[next] < 0) {
+	  //
+	  order[next] = low[next] = count++;
+
+	  Frame child = {next, at, 0};
+	  
+	  stack.push_back(child);
+	}
+	else
+	  //
+	  low[at] = std::min(low[at], order[next]);
+
+	continue;
+      }
+
+      const int parent = top.parent;
+	
+      stack.pop_back();
+
+      if(parent < 0)
+	//
+	continue;
+
+      low[parent] = std::min(low[parent], low[at]);
+
+      if(low[at] > order[parent])
+	//
+	_bridge(at, parent) = 1;
+    }
+  }
+}
+
+// check if the bond belong to a ring structure
+//
+bool PrimStruct::is_ring (int at1, int at2) const 
+{
+  const char funame [] = "PrimStruct::is_ring: ";
+
+  if(at1 == at2) {
+    //
+    std::cerr << funame << "the same atom: " << at1 << "\n";
+
+    throw Error::General();
+  }
+
+  if(!is_connected(at1, at2)) {
+    //
+    std::cerr << funame << "not connected: " << at1 << ", " << at2 << "\n";
+			   
+    throw Error::General();
+  }
+
+  if(!_bridge_done)
+    //
+    _set_bridge();
+
+  // the structure stays connected without the bond
+  //
+  return is_connected() && !_bridge(at1, at2);
+}
+
+std::string PrimStruct::group_stoicheometry (const std::list<int>& group) const
+{
+  std::map<std::string, int> st;
+
+  for(std::list<int>::const_iterator git = group.begin(); git != group.end(); ++git)
+    //
+    ++st[atom_name(*git)];
+
+  std::ostringstream res;
+  //
+  for(std::map<std::string, int>::const_iterator sit = st.begin(); sit != st.end(); ++sit)
+    //
+    res << sit->first << sit->second;
+
+  return res.str();
+}
+  
+/*
+// minimal number of bonds between two atoms
+//
+int  PrimStruct::distance (int at1, int at2) const 
+{
+  const char funame [] = "PrimStruct::distance: ";
+
+  if(size() < 2)
+    return 0;
+  if(at1 == at2)
+    return 0;
+
+  std::vector<int> curr_set;
+  curr_set.reserve(size());
+  std::vector<int>  new_set;
+  new_set.reserve(size());
+  new_set.push_back(at1);
+
+  int dist = 0;
+  while(curr_set.size() != new_set.size()) {
+    ++dist;
+    curr_set = new_set;
+    new_set.clear();
+    for(int at = 0; at < size(); ++at)
+      for(int i = 0; i < curr_set.size(); ++i)
+	if(at == curr_set[i] || (*this)(at, curr_set[i])) {
+	  if(at == at2) {
+	    return dist;
+	  }
+	  new_set.push_back(at);
+	  break;
+	}
+  }
+  if(curr_set.size() != size()) {
+    std::cout << funame << "primary structure is not connected\n";
+    throw Error::Range();
+  }
+  std::cout << funame << "at2, " << at2 << ", is out of range\n";
+  throw Error::Range();
+}
+
+*/
+
+// Zobrist key of the bond order: pseudo-random 64-bit number (splitmix64 finalizer)
+//
+unsigned long long bond_order_key (int bond, int order)
+{
+  unsigned long long x = (unsigned long long)bond * 8 + order + 0x9e3779b97f4a7c15ULL;
+
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+  return x ^ (x >> 31);
+}
+
+MolecStruct::MolecStruct (const PrimStruct& prim, const std::set<std::set<int> >& ib) 
+  : PrimStruct(prim), _bond_order(prim.size()), _single(prim.size())
+{
+  const char funame [] = "MolecStruct::MolecStruct(const PrimStruct&, const std::set<std::set<int> >&): ";
+
+  int    itemp;
+  double dtemp;
+  bool   btemp;
+  
+  const ConList& adj = adjacency();
+  
+  // sigma framework
+  //
+  for(int i = 0; i < size(); ++i)
+    //
+    for(const int* j = adj.begin(i); j != adj.end(i) && *j < i; ++j) {
+      //
+      _bond.push_back(std::make_pair(i, *j));
+      
+      std::set<int> bond;
+
+      bond.insert(i);
+	
+      bond.insert(*j);
+
+      if(ib.find(bond) == ib.end())
+	//
+	_sigma.push_back(2);
+      else
+	//
+	_sigma.push_back(1);
+    }
+
+  // checking if the primary structure is sound
+  //
+  if(!is_connected()) {
+    //
+    std::cout << funame << "primary structure is not connected\n";
+    
+    throw Error::Range();
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  
+  // free valences (doubled) of the sigma framework
+  //
+  _free_val.resize(size());
+
+  for(int i = 0; i < size(); ++i)
+    //
+    _free_val[i] = 2 * valence(i);
+
+  for(int b = 0; b < _bond.size(); ++b) {
+    //
+    _free_val[_bond[b].first]  -= _sigma[b];
+    _free_val[_bond[b].second] -= _sigma[b];
+  }
+  
+  for(int i = 0; i < size(); ++i) {
+    //
+    if(_free_val[i] < 0) {
+      //
+      std::cout << funame << i << "-th " << atom_name(i) << " atom real valence exceeds its formal valence\n";
+      
+      throw Error::Range();
+    }
+
+    if(_free_val[i])
+      //
+      _unsaturated.push_back(i);
+  }
+  
+  // getting all bonding configurations (resonances)
+  //
+  _resonance_count = 0;
+
+  _resonance_truncated = false;
+
+  _pi_sum.resize(_bond.size(), 0);
+
+  _pi_max.resize(_bond.size(), 0);
+
+  _radical.resize(size(), false);
+  
+  switch(resonance_method) {
+    //
+  case RESONANCE_MATCHING:
+    //
+    _matching_resonance(start);
+
+    break;
+
+  case RESONANCE_BFS:
+    //
+    _bfs_resonance(start);
+
+    break;
+
+  default:
+    //
+    std::cerr << funame << "unknown resonance method: " << resonance_method << "\n";
+
+    throw Error::Logic();
+  }
+
+  _set_bond_tables();
+
+  // first atom
+  //
+  _cpath.push_back(ConRec(0, -1));
+
+  // atoms already in the connectivity scheme
+  //
+  std::vector<bool> visited(size(), false);
+
+  visited[0] = true;
+
+  // atoms left to place
+  //
+  int left = size() - 1;
+
+  // reference (line #) of the previous connected atom
+  //
+  int cref = 0;
+
+  // main cycle: breadth-first search, the neighbors taken in ascending order
+  //
+  while(left) {
+    //
+    // beginning of the new group
+    //
+    _cpath[cref].begin = _cpath.size();
+
+    // previous atom
+    //
+    const int prev = _cpath[cref].atom;
+
+    if(is_linear(prev)) {
+      //
+      _cpath[cref].attr |= LIN_BOND;
+      
+      _cpath.push_back(ConRec(-1, cref));
+    }
+
+    // neighbors cycle
+    //
+    for(const int* nit = adj.begin(prev); nit != adj.end(prev); ++nit) {
+      //
+      // current atom
+      //
+      const int curr = *nit;
+
+      if(visited[curr])
+	//
+	continue;
+
+      visited[curr] = true;
+
+      --left;
+      
+      //new record
+      //
+      ConRec crec(curr, cref);
+	
+      // beta bond attribute
+      //
+      BetaData beta = is_beta(curr, prev);
+	
+      if(beta) {
+	//
+	_betvar[_cpath.size()] = beta;
+	  
+	crec.attr |= BET_BOND;
+      }
+
+      _cpath.push_back(crec);
+      //
+    } // neighbors cycle
+    
+    //
+    // end of the new group
+    //
+    _cpath[cref].end = _cpath.size();
+
+    while(_cpath[++cref].atom < 0) {}
+    //
+  } // main cycle
+
+  // atom map
+  for(int i = 0; i < _cpath.size(); ++i) {
+    //
+    itemp = _cpath[i].atom;
+    
+    if(itemp >= 0)
+      //
+      _atom_map[itemp] = i;
+  }
+    
+  /*
+  std::cout << "C_Path:\n"
+	    << std::setw(7) << "line #"
+	    << std::setw(7) << "atom"
+	    << std::setw(7) << "cref"
+	    << "\n";
+  
+  for(int i = 0; i < _cpath.size(); ++i)
+    std::cout << std::setw(7) << i
+	      << std::setw(7) << _cpath[i].atom
+	      << std::setw(7) << _cpath[i].cref
+	      << "\n";
+  */
+    
+  _coval.resize(2, 3, _cpath.size());
+
+  _coatom.resize(3 * _cpath.size());
+
+  _zref.resize(3 * _cpath.size(), -1);
+  
+  int  lroot = -1;
+
+  bool lsingle;
+
+  std::ostringstream to;
+  //
+  to << std::left;
+  
+  // constructing z-matrix
+  //
+  for(int ref0 = 0; ref0 < _cpath.size(); ++ref0) {
+    //
+    int ref1, ref2, ref3;
+    
+    // atom name
+    //
+    if(_cpath[ref0].atom < 0) {
+      //
+      to << "X ";
+    }
+    else {
+      //
+      to << std::setw(2) << atom_name(_cpath[ref0].atom);
+    }
+    
+    // first reference (distance)
+    //
+    if(ref0 > 0) {
+      //
+      ref1 = _cpath[ref0].cref;
+      
+      to << ", " << std::setw(2) << ref1 + 1 << ", " << var_name(DISTANCE) << std::setw(2) << ref0;
+
+      _zref[DISTANCE + 3 * ref0] = ref1;
+
+      if(_cpath[ref0].atom < 0) {
+	//
+	_coval(DISTANCE, ref0) = 1.;
+
+	_constvar.push_back(DISTANCE + 3 * ref0);
+      }
+      else {
+	//
+	_set_coval(DISTANCE, ref0, _cpath[ref0].atom, _cpath[ref1].atom);
+      }
+    }
+
+    // second reference (polar angle)
+    //
+    if(ref0 > 1) {
+      //
+      // ref1 linear
+      //
+      if(_cpath[ref1].attr & LIN_BOND) {
+	//
+	// dummy atom
+	//
+	if(_cpath[ref0].atom < 0) {
+	  //
+	  ref2 = _cpath[ref1].cref;
+
+	  _constvar.push_back(POLAR + 3 * ref0);
+	}
+	// real atom
+	//
+	else {
+	  //
+	  // dummy atom
+	  //
+	  ref2 = _cpath[ref1].begin;
+	}
+	
+	_coval(POLAR, ref0) = 90.;
+      }
+      //
+      // ref1 nonlinear
+      //
+      else {
+	//
+	// root atom
+	//
+	if(!ref1) {
+	  //
+	  ref2 = 1;
+	}
+	//
+	else {
+	  //
+	  ref2 = _cpath[ref1].cref;
+	}
+
+	_set_coval(POLAR, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom);
+      }
+      
+      to << ", " << std::setw(2) << ref2 + 1 << ", " << var_name(POLAR) << std::setw(2) << ref0;
+
+      _zref[POLAR + 3 * ref0] = ref2;
+    }
+
+    // third reference (dihedral angle)
+    //
+    if(ref0 > 2) {
+      //
+      // ref1 linear
+      //
+      if(_cpath[ref1].attr & LIN_BOND) {
+	//
+	// dummy atom
+	//
+	if(_cpath[ref0].atom < 0) {
+	  //
+	  if(_cpath[ref2].attr & LIN_BOND) {
+	    //
+	    // ref2 dummy atom
+	    //
+	    ref3 = _cpath[ref2].begin;
+	  }
+	  else if(ref2) {
+	    //
+	    ref3 = _cpath[ref2].cref;
+	  }
+	  else if(ref1 == 1) {
+	    //
+	    ref3 = 2;
+	  }
+	  else {
+	    //
+ 	    ref3 = 1;
+	  }	  
+
+	  _coval(DIHEDRAL, ref0) = 0.;
+
+	  _constvar.push_back(DIHEDRAL + 3 * ref0);
+	}
+	//
+	// real atom
+	//
+	else {
+	  //
+	  // ref1 is root
+	  //
+	  if(!ref1) {
+	    //
+	    ref3 = 2;
+	  }
+	  else {
+	    //
+	    ref3 = _cpath[ref1].cref;
+	  }	 
+
+	  _coval(DIHEDRAL, ref0) = 180.;
+	}
+      }
+      //
+      // ref1 nonlinear
+      //
+      else {
+	//
+	bool islin = false;
+
+	bool isring = is_ring(_cpath[ref1].atom, _cpath[ref2].atom);
+	
+	bool isingle = is_single(_cpath[ref1].atom, _cpath[ref2].atom);
+
+	//std::cout << "atoms: " << _cpath[ref1].atom << ", " << _cpath[ref2].atom << ": is ring? " << isring << std::endl;
+	
+	bool isrot = !isring && isingle;
+
+	// not the first atom in the group
+	//
+	if(ref0 != _cpath[ref1].begin) {
+	  //
+	  if(!ref1) {
+	    //
+	    ref3 = 2;
+	  }
+	  else {
+	    //
+	    ref3 = _cpath[ref1].begin;
+	  }
+
+	  isrot = false;
+	}
+	// ref2 is linear
+	//
+	else if(_cpath[ref2].attr & LIN_BOND) {
+	  //
+	  islin = true;
+	  
+	  // ref2 dummy atom as dihedral reference ref3
+	  //
+	  ref3 = _cpath[ref2].begin;
+	  
+	  int curr = ref2;
+
+	  int prev = ref1;
+
+	  while(curr && _cpath[curr].attr & LIN_BOND) {
+	    //
+	    if(is_single(_cpath[curr].atom, _cpath[prev].atom))
+	      //
+	      isingle = true;
+
+	    prev = curr;
+
+	    curr = _cpath[curr].cref;
+	  }
+	  
+	  isrot = !isring && isingle;
+
+	  // nonlinear non-root atom
+	  //
+	  if(curr) {
+	    //
+	    curr = _cpath[curr].cref;
+
+	    _set_coval(DIHEDRAL, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom, _cpath[curr].atom);
+	  }
+	  //
+	  // root atom
+	  //
+	  else {
+	    //
+	    // linear root
+	    //
+	    if(_cpath[curr].attr & LIN_BOND) {
+	      //
+	      // first approach to the linear root
+	      //
+	      if(lroot < 0) {
+		//
+		lroot = _cpath[ref0].atom;
+
+		lsingle = isingle;
+
+		_coval(DIHEDRAL, ref0) = 0.;
+
+		_constvar.push_back(DIHEDRAL + 3 * ref0);
+
+		isrot = false;
+	      }
+	      // second approach to the linear root
+	      //
+	      else {
+		//
+		_set_coval(DIHEDRAL, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom, lroot);
+
+		isrot = !isring && (isingle || lsingle);
+	      }
+	    }
+	    // nonlinear root
+	    //
+	    else {
+	      //
+	      // terminal root
+	      //
+	      if(degree(0) == 1) {
+		//
+		_coval(DIHEDRAL, ref0) = 0.;
+
+		_constvar.push_back(DIHEDRAL + 3 * ref0);
+
+		isrot = false;
+	      }
+	      // root with several bonds
+	      //
+	      else if(prev == 1) {
+		//
+		_set_coval(DIHEDRAL, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom, _cpath[2].atom);
+	      }
+	      else {
+		//
+		_set_coval(DIHEDRAL, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom, _cpath[1].atom);
+	      }
+	    }
+	  }
+	  //
+	  //
+	} // ref2 is linear
+	//
+	else if(ref2) {
+	  //
+	  ref3 = _cpath[ref2].cref;
+	}
+	else if(ref1 == 1) {
+	  //
+	  ref3 = 2;
+	}
+	else {
+	  //
+	  ref3 = 1;
+	}
+
+	if(!islin) {
+	  //
+	  _set_coval(DIHEDRAL, ref0, _cpath[ref0].atom, _cpath[ref1].atom, _cpath[ref2].atom, _cpath[ref3].atom);
+	}
+
+	if(isrot) {
+	  //
+	  _rotvar[ref0] = bridge_group(_cpath[ref1].atom, _cpath[ref2].atom);
+
+	  for(std::list<std::list<int> >::iterator git = _rotvar[ref0].begin(); git != _rotvar[ref0].end(); ++git) {
+	    //
+	    for(std::list<int>::iterator it = git->begin(); it != git->end(); ++it)
+	      //
+	      if(*it == _cpath[ref1].atom || *it == _cpath[ref2].atom) {
+		//
+		itemp = *it;
+		
+		git->erase(it);
+		
+		git->push_front(itemp);
+		
+		break;
+	      }
+	  }
+	}
+	//
+	//
+      } // ref1 is nonlinear
+      
+      to << ", " << std::setw(2) << ref3 + 1 << ", " << var_name(DIHEDRAL) << std::setw(2) << ref0;
+
+      _zref[DIHEDRAL + 3 * ref0] = ref3;
+      //
+      //
+    } // dihedral angle value and reference
+
+    to << "\n";
+  }
+  
+  _zmat = to.str();
+
+  // z-matrix variables
+  //
+  std::set<int> cvar(_constvar.begin(), _constvar.end());
+
+  for(int ref0 = 1; ref0 < _cpath.size(); ++ref0)
+    //
+    for(int var = DISTANCE; var <= DIHEDRAL && var < ref0; ++var)
+      //
+      if(cvar.find(var + 3 * ref0) == cvar.end())
+	//
+	_zvar.push_back(var + 3 * ref0);
+}
+
+// z-matrix coordinate value: the distance, the polar angle, or the dihedral angle,
+// depending on the number of the defining atoms
+//
+template <typename G>
+double zmat_coord (const std::vector<int>& at, const G& g)
+{
+  switch(at.size()) {
+    //
+  case 2:
+    //
+    return (g[at[0]] - g[at[1]]).vlength();
+
+  case 3:
+    //
+    return angle(g[at[0]], g[at[1]], g[at[2]]);
+
+  case 4:
+    //
+    return angle(g[at[0]], g[at[1]], g[at[2]], g[at[3]]);
+  }
+
+  std::cerr << "zmat_coord: wrong number of atoms: " << at.size() << "\n";
+
+  throw Error::Logic();
+}
+
+void MolecStruct::_set_coval (int var, int ref0, int at0, int at1, int at2, int at3)
+{
+  std::vector<int>& at = _coatom[var + 3 * ref0];
+
+  const int a [] = {at0, at1, at2, at3};
+
+  at.clear();
+
+  for(int i = 0; i < 4 && a[i] >= 0; ++i)
+    //
+    at.push_back(a[i]);
+
+  _coval(var, ref0) = zmat_coord(at, (const PrimStruct&)*this);
+}
+
+// z-matrix coordinates values for the new geometry of the same species: the connectivity
+// scheme, the z-matrix, and the rotational and beta-scission bonds are kept
+//
+void MolecStruct::update_zmat_coval (const ::MolecGeom& geom)
+{
+  const char funame [] = "MolecStruct::update_zmat_coval: ";
+
+  if(geom.size() != size()) {
+    //
+    std::cerr << funame << "wrong number of atoms: " << geom.size() << "\n";
+
+    throw Error::Range();
+  }
+
+  for(int i = 0; i < size(); ++i)
+    //
+    if((const AtomBase&)geom[i] != (const AtomBase&)(*this)[i]) {
+      //
+      std::cerr << funame << i << "-th atom: wrong type: " << geom[i].name() << "\n";
+
+      throw Error::Range();
+    }
+
+  for(int v = 0; v < _coatom.size(); ++v)
+    //
+    if(_coatom[v].size())
+      //
+      _coval(v % 3, v / 3) = zmat_coord(_coatom[v], geom);
+}
+
+// z-matrix coordinates of the frames block: the atomic positions are stored as the
+// structure of arrays, x, y, and z components of each atom for all frames in the block
+// in a row, so that the inner cycles over the frames are vectorized
+//
+const int zmat_block = 64;
+
+void block_distance (int n, const double* const* p, double* res)
+{
+  const double* a = p[0];
+  const double* b = p[1];
+  
+  for(int f = 0; f < n; ++f) {
+    //
+    const double dx = a[f] - b[f];
+    const double dy = a[f + zmat_block] - b[f + zmat_block];
+    const double dz = a[f + 2 * zmat_block] - b[f + 2 * zmat_block];
+
+    res[f] = std::sqrt(dx * dx + dy * dy + dz * dz);
+  }
+}
+
+void block_polar (int n, const double* const* p, double* res)
+{
+  const double* a = p[0];
+  const double* b = p[1];
+  const double* c = p[2];
+  
+  for(int f = 0; f < n; ++f) {
+    //
+    const double x1 = a[f] - b[f];
+    const double y1 = a[f + zmat_block] - b[f + zmat_block];
+    const double z1 = a[f + 2 * zmat_block] - b[f + 2 * zmat_block];
+
+    const double x2 = c[f] - b[f];
+    const double y2 = c[f + zmat_block] - b[f + zmat_block];
+    const double z2 = c[f + 2 * zmat_block] - b[f + 2 * zmat_block];
+
+    double cs = (x1 * x2 + y1 * y2 + z1 * z2) / std::sqrt((x1 * x1 + y1 * y1 + z1 * z1) * (x2 * x2 + y2 * y2 + z2 * z2));
+
+    cs = cs < -1. ? -1. : cs > 1. ? 1. : cs;
+
+    res[f] = std::acos(cs) * 180. / M_PI;
+  }
+}
+
+void block_dihedral (int n, const double* const* p, double* res)
+{
+  const double* a = p[0];
+  const double* b = p[1];
+  const double* c = p[2];
+  const double* d = p[3];
+  
+  for(int f = 0; f < n; ++f) {
+    //
+    const double nx = c[f] - b[f];
+    const double ny = c[f + zmat_block] - b[f + zmat_block];
+    const double nz = c[f + 2 * zmat_block] - b[f + 2 * zmat_block];
+
+    double x1 = a[f] - b[f];
+    double y1 = a[f + zmat_block] - b[f + zmat_block];
+    double z1 = a[f + 2 * zmat_block] - b[f + 2 * zmat_block];
+
+    double x2 = d[f] - c[f];
+    double y2 = d[f + zmat_block] - c[f + zmat_block];
+    double z2 = d[f + 2 * zmat_block] - c[f + 2 * zmat_block];
+
+    const double nn = nx * nx + ny * ny + nz * nz;
+    
+    const double p1 = (x1 * nx + y1 * ny + z1 * nz) / nn;
+    const double p2 = (x2 * nx + y2 * ny + z2 * nz) / nn;
+
+    x1 -= p1 * nx;
+    y1 -= p1 * ny;
+    z1 -= p1 * nz;
+
+    x2 -= p2 * nx;
+    y2 -= p2 * ny;
+    z2 -= p2 * nz;
+    
+    const double norm = std::sqrt((x1 * x1 + y1 * y1 + z1 * z1) * (x2 * x2 + y2 * y2 + z2 * z2));
+
+    double cs = (x1 * x2 + y1 * y2 + z1 * z2) / norm;
+
+    cs = cs < -1. ? -1. : cs > 1. ? 1. : cs;
+
+    const double ang = std::acos(cs) * 180. / M_PI;
+
+    // the sign of the (n x v1) v2 volume
+    //
+    const double vol = (ny * z1 - nz * y1) * x2 + (nz * x1 - nx * z1) * y2 + (nx * y1 - ny * x1) * z2;
+
+    res[f] = norm < 1.e-8 ? 0. : vol > 0. ? ang : 360. - ang;
+  }
+}
+
+// z-matrix variables values for the trajectory frames: the positions of the atoms
+// (nframe x size() x 3, in the structure geometry units) are converted to the table
+// (nframe x zmat_var().size()) row by row
+//
+void MolecStruct::zmat_trajectory (int nframe, const double* xyz, double* table) const
+{
+  const int nvar = _zvar.size();
+
+  // atomic positions of the frames block
+  //
+  std::vector<double> pos(3 * size() * zmat_block);
+
+  std::vector<double> val(zmat_block);
+
+  const double* p [4];
+  
+  for(int f0 = 0; f0 < nframe; f0 += zmat_block) {
+    //
+    const int n = std::min(zmat_block, nframe - f0);
+
+    for(int f = 0; f < n; ++f)
+      //
+      for(int a = 0; a < size(); ++a)
+	//
+	for(int i = 0; i < 3; ++i)
+	  //
+	  pos[(3 * a + i) * zmat_block + f] = xyz[((f0 + f) * size() + a) * 3 + i];
+
+    for(int v = 0; v < nvar; ++v) {
+      //
+      const std::vector<int>& at = _coatom[_zvar[v]];
+
+      double* out = table + f0 * nvar + v;
+      
+      // fixed value
+      //
+      if(!at.size()) {
+	//
+	const double x = _coval(_zvar[v] % 3, _zvar[v] / 3);
+
+	for(int f = 0; f < n; ++f)
+	  //
+	  out[f * nvar] = x;
+
+	continue;
+      }
+
+      for(int i = 0; i < at.size(); ++i)
+	//
+	p[i] = &pos[3 * at[i] * zmat_block];
+
+      switch(at.size()) {
+	//
+      case 2:
+	//
+	block_distance(n, p, &val[0]);
+
+	break;
+
+      case 3:
+	//
+	block_polar(n, p, &val[0]);
+
+	break;
+
+      default:
+	//
+	block_dihedral(n, p, &val[0]);
+      }
+
+      for(int f = 0; f < n; ++f)
+	//
+	out[f * nvar] = val[f];
+    }
+  }
+}
+
+// Cartesian coordinates for the z-matrix variables sets (Natural Extension Reference
+// Frame): the z-matrix line is placed in the frame of its three references; the first
+// line is at the origin, the second one on the z axis, and the third one in the xz plane;
+// the dummy atoms are placed but not returned
+//
+void MolecStruct::zmat_cartesian (int nset, const double* var, double* xyz) const
+{
+  const int nvar = _zvar.size();
+
+  const int nline = _cpath.size();
+
+  // z-matrix lines positions for each worker
+  //
+  std::vector<std::vector<D3::Vector> > scratch(worker_count(nset), std::vector<D3::Vector>(nline));
+
+  parallel_for(nset, [&] (int set, int worker) {
+      //
+      std::vector<D3::Vector>& pos = scratch[worker];
+
+      // z-matrix coordinates values
+      //
+      MultiArray<double> coval = _coval;
+
+      for(int v = 0; v < nvar; ++v)
+	//
+	coval(_zvar[v] % 3, _zvar[v] / 3) = var[set * nvar + v];
+
+      for(int ref0 = 0; ref0 < nline; ++ref0) {
+	//
+	D3::Vector& d = pos[ref0];
+
+	d = 0.;
+
+	if(!ref0)
+	  //
+	  continue;
+
+	const double r = coval(DISTANCE, ref0);
+
+	const D3::Vector& c = pos[_zref[DISTANCE + 3 * ref0]];
+
+	if(ref0 == 1) {
+	  //
+	  d[2] = r;
+
+	  continue;
+	}
+
+	const D3::Vector& b = pos[_zref[POLAR + 3 * ref0]];
+
+	const double theta = coval(POLAR, ref0) * M_PI / 180.;
+
+	// dihedral reference: a point off the axis for the third line
+	//
+	D3::Vector a;
+
+	double phi = 0.;
+
+	if(ref0 == 2) {
+	  //
+	  a = b;
+
+	  a[0] += 1.;
+	}
+	else {
+	  //
+	  a = pos[_zref[DIHEDRAL + 3 * ref0]];
+
+	  phi = coval(DIHEDRAL, ref0) * M_PI / 180.;
+	}
+
+	// local frame
+	//
+	D3::Vector bc = c - b;
+
+	bc.normalize();
+
+	D3::Vector n = vprod(b - a, bc);
+
+	n.normalize();
+
+	const D3::Vector m = vprod(n, bc);
+
+	d = c + bc * (-r * std::cos(theta)) + m * (r * std::sin(theta) * std::cos(phi)) + n * (r * std::sin(theta) * std::sin(phi));
+      }
+
+      for(int ref0 = 0; ref0 < nline; ++ref0)
+	//
+	if(_cpath[ref0].atom >= 0)
+	  //
+	  for(int i = 0; i < 3; ++i)
+	    //
+	    xyz[(set * size() + _cpath[ref0].atom) * 3 + i] = pos[ref0][i];
+    });
+}
+
+// atom-to-zmatrix map
+//
+int MolecStruct::atom_map (int i) const
+{
+  std::map<int, int>::const_iterator it = _atom_map.find(i);
+  
+  if(it != _atom_map.end())
+    //
+    return it->second;
+  
+  return -1;
+}
+
+void MolecStruct::print (std::ostream& to, const std::string& offset) const
+{
+  const PrimStruct& m = *this;
+  
+  double dtemp;
+  bool   btemp;
+  int    itemp;
+
+  int old_precision = to.precision(2);
+
+  to << offset << "Molecular structure:";
+
+  if(_resonance_count > 1 || _resonance_truncated) {
+    //
+    to << " resonantly stabilized (" << _resonance_count << " resonances" ;
+
+    if(_resonance_truncated)
+      //
+      to << ", enumeration truncated";
+
+    to << ")";
+  }
+
+  to << "\n\n"; 
+
+  to << offset << "   A\\A  ";
+
+  for(int i = 0; i < size(); ++i) {
+    //
+    to << std::setw(3) <<  atom_name(i);
+
+    if(i < 9) {
+      //
+      to << i + 1 << " ";
+    }
+    else
+      //
+      to << i + 1;
+  }
+
+  to << "\n\n";
+
+  for(int j = 0; j < size(); ++j) {
+    //
+    to << offset << std::setw(4) << atom_name(j);
+
+    if(j < 9) {
+      //
+      to << j + 1 << " ";
+    }
+    else
+      //
+      to << j + 1;
+
+    for(int i = 0; i < j; ++i) {
+      //
+      to << std::setw(5) << bond_order(i, j);
+    }
+
+    to << std::setw(5) << "X" << "\n\n";
+  }
+
+  to << "\n";
+
+  std::vector<int> rs_vec;
+
+  for(int rad = 0; rad < size(); ++rad) {
+    //
+    btemp = false;
+
+    if(is_radical(rad))
+      //
+      rs_vec.push_back(rad);
+  }
+
+  if(rs_vec.size() > 1) {
+    to << offset << "Free radical: Radical sites are ";
+    for(int i = 0; i < rs_vec.size(); ++i) {
+      itemp = rs_vec[i];
+      to << atom_name(itemp) << itemp + 1 << " ";
+    }
+  }
+  else if(rs_vec.size() == 1) {
+    itemp = rs_vec[0];
+    to << offset << "Free radical: Radical site is "
+       << atom_name(itemp) << itemp + 1 << " ";
+  }
+  to << "\n\n";
+
+  to << "Z-Matrix atom order:\n";
+
+  for(int i = 0; i < _cpath.size(); ++i) {
+    //
+    to << std::setw(2) << i + 1 << " --> " << std::setw(2);
+
+    if(_cpath[i].atom < 0) {
+      //
+      to << "X";
+    }
+    else
+      //
+      to << _cpath[i].atom + 1;
+    
+    to << "\n";
+  }
+
+  to << "\n";
+  
+  to.precision(old_precision);
+}
+
+std::vector<int> MolecStruct::atom_ordering() const
+{
+  unsigned int n = _cpath.size();
+  std::vector<int> order(n);
+
+  for(unsigned int i = 0; i < n; ++i)
+    order[i] = _cpath[i].atom;
+
+  return order;
+}
+
+// all resonances by the breadth-first bond increment: the last generation of the
+// resonances which can be incremented
+//
+void MolecStruct::_bfs_resonance (std::chrono::steady_clock::time_point start)
+{
+  std::vector<Resonance> resonance(1);
+
+  // resonance hashes
+  //
+  std::vector<unsigned long long> res_hash(1, 0);
+
+  // resonances expanded
+  //
+  std::atomic<int> r_count(0);
+
+  // out of time
+  //
+  std::atomic<bool> stop(false);
+  
+  // bond increment cycle
+  //
+  while(1) {
+    //
+    // the current generation is split into chunks expanded in parallel, each into its own
+    // candidates buffer; the buffers are then merged in the chunks order, so that the
+    // resonances order does not depend on the number of threads
+    //
+    const int nchunk = std::min((int)resonance.size(), 8 * worker_count(resonance.size()));
+
+    std::vector<std::vector<Resonance> > cand(nchunk);
+
+    std::vector<std::vector<unsigned long long> > cand_hash(nchunk);
+
+    parallel_for(nchunk, [&] (int chunk, int) {
+	//
+	std::vector<int> curr_val(size());
+
+	// chunk candidates with the given hash
+	//
+	std::unordered_map<unsigned long long, std::vector<int> > known;
+    
+	for(int r = resonance.size() * chunk / nchunk; r < resonance.size() * (chunk + 1) / nchunk; ++r) {
+	  //
+	  // out of time
+	  //
+	  if(stop || (!(++r_count & 1023) && resonance_time_over(start))) {
+	    //
+	    stop = true;
+
+	    return;
+	  }
+      
+	  const Resonance& res = resonance[r];
+      
+	  // free valences of the resonance
+	  //
+	  curr_val = _free_val;
+
+	  for(Resonance::const_iterator it = res.begin(); it != res.end(); ++it) {
+	    //
+	    curr_val[_bond[it->first].first]  -= 2 * it->second;
+	    curr_val[_bond[it->first].second] -= 2 * it->second;
+	  }
+
+	  for(int b = 0; b < _bond.size(); ++b) {
+	    //
+	    if(curr_val[_bond[b].first] < 2 || curr_val[_bond[b].second] < 2)
+	      //
+	      continue;
+
+	    const int order = 2 * _increment(res, b);
+	
+	    const unsigned long long hash = res_hash[r] ^ bond_order_key(b, order) ^ bond_order_key(b, order + 2);
+
+	    // new resonance
+	    //
+	    Resonance test = res;
+
+	    Resonance::iterator it = std::lower_bound(test.begin(), test.end(), std::make_pair(b, (unsigned char)0));
+
+	    if(it != test.end() && it->first == b)
+	      //
+	      ++it->second;
+	    else
+	      //
+	      test.insert(it, std::make_pair(b, (unsigned char)1));
+
+	    // already known
+	    //
+	    std::vector<int>& same = known[hash];
+
+	    bool btemp = false;
+	      
+	    for(std::vector<int>::const_iterator sit = same.begin(); sit != same.end(); ++sit)
+	      //
+	      if(cand[chunk][*sit] == test) {
+		//
+		btemp = true;
+
+		break;
+	      }
+
+	    if(btemp)
+	      //
+	      continue;
+
+	    same.push_back(cand[chunk].size());
+	    
+	    cand[chunk].push_back(test);
+	    
+	    cand_hash[chunk].push_back(hash);
+	  }
+	}
+      });
+
+    if(stop)
+      //
+      break;
+
+    // candidates positions in the chunks order
+    //
+    std::vector<std::pair<int, int> > pos;
+
+    for(int c = 0; c < nchunk; ++c)
+      //
+      for(int i = 0; i < cand[c].size(); ++i)
+	//
+	pos.push_back(std::make_pair(c, i));
+
+    // stop condition
+    //
+    if(!pos.size())
+      //
+      break;
+
+    // candidates are distributed between the hash shards, and the duplicates are found
+    // in each shard independently: the first candidate in the chunks order is kept
+    //
+    const int nshard = 8 * worker_count(pos.size());
+
+    std::vector<std::vector<int> > shard(nshard);
+
+    for(int p = 0; p < pos.size(); ++p)
+      //
+      shard[cand_hash[pos[p].first][pos[p].second] % nshard].push_back(p);
+
+    std::vector<char> is_dup(pos.size(), 0);
+
+    parallel_for(nshard, [&] (int sh, int) {
+	//
+	std::unordered_map<unsigned long long, std::vector<int> > known;
+
+	for(std::vector<int>::const_iterator p = shard[sh].begin(); p != shard[sh].end(); ++p) {
+	  //
+	  const Resonance& test = cand[pos[*p].first][pos[*p].second];
+
+	  std::vector<int>& same = known[cand_hash[pos[*p].first][pos[*p].second]];
+
+	  for(std::vector<int>::const_iterator sit = same.begin(); sit != same.end(); ++sit)
+	    //
+	    if(cand[pos[*sit].first][pos[*sit].second] == test) {
+	      //
+	      is_dup[*p] = 1;
+
+	      break;
+	    }
+
+	  if(!is_dup[*p])
+	    //
+	    same.push_back(*p);
+	}
+      });
+    
+    // update resonance
+    //
+    std::vector<Resonance> update;
+
+    std::vector<unsigned long long> update_hash;
+
+    for(int p = 0; p < pos.size(); ++p) {
+      //
+      if(is_dup[p])
+	//
+	continue;
+
+      update.push_back(Resonance());
+
+      update.back().swap(cand[pos[p].first][pos[p].second]);
+
+      update_hash.push_back(cand_hash[pos[p].first][pos[p].second]);
+    }
+
+    resonance.swap(update);
+
+    res_hash.swap(update_hash);
+
+    if(resonance_time_over(start)) {
+      //
+      stop = true;
+
+      break;
+    }
+    //
+  }// bond increment cycle
+
+  // out of time: the last generation stands for the resonances if its placements are maximal,
+  // otherwise the maximal placement found by the matching does
+  //
+  if(stop) {
+    //
+    _resonance_truncated = true;
+
+    const ResonanceGenerator gen(*this, start);
+
+    int total = 0;
+
+    for(Resonance::const_iterator it = resonance[0].begin(); it != resonance[0].end(); ++it)
+      //
+      total += it->second;
+
+    if(total < gen.pi_bond_count())
+      //
+      resonance.assign(1, gen.max_resonance());
+  }
+
+  std::vector<int> used(size());
+
+  for(int r = 0; r < resonance.size(); ++r) {
+    //
+    if(resonance_limit > 0 && r == resonance_limit) {
+      //
+      _resonance_truncated = true;
+
+      break;
+    }
+
+    _add_resonance(resonance[r], used);
+  }
+}
+
+// all resonances as the maximal pi bond placements
+//
+void MolecStruct::_matching_resonance (std::chrono::steady_clock::time_point start)
+{
+  ResonanceGenerator gen(*this, start);
+
+  Resonance res;
+
+  std::vector<int> used(size());
+
+  while(gen.next(res)) {
+    //
+    // at least one resonance is needed
+    //
+    if(_resonance_count && (_resonance_count == resonance_limit || resonance_time_over(start))) {
+      //
+      _resonance_truncated = true;
+
+      break;
+    }
+
+    _add_resonance(res, used);
+  }
+
+  // out of time in the search: the maximal placement from the matching stands for the resonances
+  // if none has been found
+  //
+  if(gen.is_timeout()) {
+    //
+    _resonance_truncated = true;
+
+    if(!_resonance_count)
+      //
+      _add_resonance(gen.max_resonance(), used);
+  }
+}
+
+// accumulate the resonance statistics; used is a zero-filled work space of the molecule size
+//
+void MolecStruct::_add_resonance (const Resonance& res, std::vector<int>& used)
+{
+  ++_resonance_count;
+
+  for(Resonance::const_iterator it = res.begin(); it != res.end(); ++it) {
+    //
+    _pi_sum[it->first] += it->second;
+
+    if(it->second > _pi_max[it->first])
+      //
+      _pi_max[it->first] = it->second;
+
+    used[_bond[it->first].first]  += 2 * it->second;
+    used[_bond[it->first].second] += 2 * it->second;
+  }
+
+  for(std::vector<int>::const_iterator at = _unsaturated.begin(); at != _unsaturated.end(); ++at)
+    //
+    if(_free_val[*at] > used[*at])
+      //
+      _radical[*at] = true;
+
+  for(Resonance::const_iterator it = res.begin(); it != res.end(); ++it) {
+    //
+    used[_bond[it->first].first]  = 0;
+    used[_bond[it->first].second] = 0;
+  }
+}
+
+// bond orders averaged over the resonances and the bonds which are single in all of them;
+// the per bond accumulators are not needed afterwards
+//
+void MolecStruct::_set_bond_tables ()
+{
+  for(int b = 0; b < _bond.size(); ++b) {
+    //
+    const int i = _bond[b].first;
+    const int j = _bond[b].second;
+    
+    _bond_order(i, j) = ((double)_sigma[b] * (double)_resonance_count + 2. * (double)_pi_sum[b])
+      / ((double)_resonance_count * 2.);
+
+    _single(i, j) = _sigma[b] + 2 * _pi_max[b] <= 2;
+  }
+
+  std::vector<long long>().swap(_pi_sum);
+
+  std::vector<unsigned char>().swap(_pi_max);
+}
+
+// maximum cardinality matching of the general graph by the Edmonds blossom algorithm: the
+// augmenting paths are looked for from each free vertex in turn, the odd cycles (blossoms)
+// being contracted to their bases
+//
+int blossom_lca (const std::vector<int>& mate, const std::vector<int>& base, const std::vector<int>& parent, int a, int b)
+{
+  std::vector<bool> used(mate.size(), false);
+
+  while(1) {
+    //
+    a = base[a];
+
+    used[a] = true;
+
+    if(mate[a] < 0)
+      //
+      break;
+
+    a = parent[mate[a]];
+  }
+
+  while(1) {
+    //
+    b = base[b];
+
+    if(used[b])
+      //
+      return b;
+
+    b = parent[mate[b]];
+  }
+}
+
+void blossom_path (const std::vector<int>& mate, const std::vector<int>& base, std::vector<int>& parent,
+		   std::vector<bool>& blossom, int v, int b, int child)
+{
+  while(base[v] != b) {
+    //
+    blossom[base[v]] = blossom[base[mate[v]]] = true;
+
+    parent[v] = child;
+
+    child = mate[v];
+
+    v = parent[mate[v]];
+  }
+}
+
+int max_matching (const std::vector<std::vector<int> >& adj, std::vector<int>& mate)
+{
+  const int n = adj.size();
+
+  mate.assign(n, -1);
+
+  int res = 0;
+
+  // greedy start
+  //
+  for(int v = 0; v < n; ++v)
+    //
+    for(int i = 0; mate[v] < 0 && i < adj[v].size(); ++i)
+      //
+      if(mate[adj[v][i]] < 0) {
+	//
+	mate[v] = adj[v][i];
+
+	mate[adj[v][i]] = v;
+
+	++res;
+      }
+
+  std::vector<int> parent(n), base(n), queue;
+
+  std::vector<bool> used(n), blossom(n);
+
+  for(int root = 0; root < n; ++root) {
+    //
+    if(mate[root] >= 0)
+      //
+      continue;
+
+    // augmenting path search
+    //
+    parent.assign(n, -1);
+
+    used.assign(n, false);
+
+    for(int v = 0; v < n; ++v)
+      //
+      base[v] = v;
+
+    used[root] = true;
+
+    queue.assign(1, root);
+
+    int end = -1;
+
+    for(int q = 0; end < 0 && q < queue.size(); ++q) {
+      //
+      const int v = queue[q];
+
+      for(int i = 0; end < 0 && i < adj[v].size(); ++i) {
+	//
+	const int to = adj[v][i];
+
+	if(base[v] == base[to] || mate[v] == to)
+	  //
+	  continue;
+
+	// blossom
+	//
+	if(to == root || (mate[to] >= 0 && parent[mate[to]] >= 0)) {
+	  //
+	  const int b = blossom_lca(mate, base, parent, v, to);
+
+	  blossom.assign(n, false);
+
+	  blossom_path(mate, base, parent, blossom, v, b, to);
+	  blossom_path(mate, base, parent, blossom, to, b, v);
+
+	  for(int u = 0; u < n; ++u)
+	    //
+	    if(blossom[base[u]]) {
+	      //
+	      base[u] = b;
+
+	      if(!used[u]) {
+		//
+		used[u] = true;
+
+		queue.push_back(u);
+	      }
+	    }
+	}
+	else if(parent[to] < 0) {
+	  //
+	  parent[to] = v;
+
+	  if(mate[to] < 0) {
+	    //
+	    end = to;
+	  }
+	  else {
+	    //
+	    used[mate[to]] = true;
+
+	    queue.push_back(mate[to]);
+	  }
+	}
+      }
+    }
+
+    // augmentation
+    //
+    if(end < 0)
+      //
+      continue;
+
+    ++res;
+
+    for(int v = end; v >= 0;) {
+      //
+      const int pv = parent[v];
+
+      const int next = mate[pv];
+
+      mate[v] = pv;
+
+      mate[pv] = v;
+
+      v = next;
+    }
+  }
+
+  return res;
+}
+
+// the sigma framework bonds between unsaturated atoms are visited in the lower atom index
+// order, and the number of pi bonds added to each is chosen in turn, so that every placement
+// is generated exactly once; the branches which cannot reach the target number of pi bonds
+// are cut; the target, the largest number of pi bonds, is found by the matching first
+//
+MolecStruct::ResonanceGenerator::ResonanceGenerator (const MolecStruct& m, std::chrono::steady_clock::time_point start)
+  : _cap(m.size()), _left(m.size(), 0), _free(0), _total(0), _target(0), _pos(0), _state(0),
+    _start(start), _node(0), _timeout(false)
+{
+  // pi bond capacities
+  //
+  for(int a = 0; a < m.size(); ++a)
+    //
+    _cap[a] = m._free_val[a] / 2;
+
+  // conjugated subgraph bonds in the order of the lower index atom
+  //
+  std::vector<std::pair<std::pair<int, int>, int> > order;
+
+  for(int b = 0; b < m._bond.size(); ++b)
+    //
+    if(_cap[m._bond[b].first] && _cap[m._bond[b].second])
+      //
+      order.push_back(std::make_pair(std::make_pair(m._bond[b].second, m._bond[b].first), b));
+
+  std::sort(order.begin(), order.end());
+
+  for(int s = 0; s < order.size(); ++s) {
+    //
+    _slot.push_back(order[s].second);
+
+    _atom.push_back(order[s].first);
+
+    ++_left[_atom.back().first];
+    ++_left[_atom.back().second];
+  }
+
+  _count.resize(_slot.size(), 0);
+
+  for(int a = 0; a < m.size(); ++a)
+    //
+    if(_left[a])
+      //
+      _free += _cap[a];
+
+  _set_target(m);
+}
+
+// the largest number of pi bonds is the maximum b-matching of the conjugated subgraph, the
+// atoms pi bond capacities being the degree bounds; it is reduced to the maximum matching:
+// each atom is split into its capacity copies, and each unit of the slot pi bond multiplicity
+// into two vertices, joined together and to all the copies of the respective slot atom, so
+// that the unit matched to the atoms copies is the pi bond placed
+//
+void MolecStruct::ResonanceGenerator::_set_target (const MolecStruct& m)
+{
+  // atoms copies
+  //
+  std::vector<int> copy(m.size());
+
+  int n = 0;
+
+  for(int a = 0; a < m.size(); ++a) {
+    //
+    copy[a] = n;
+
+    if(_left[a])
+      //
+      n += _cap[a];
+  }
+
+  std::vector<std::vector<int> > adj(n);
+
+  // the slot units vertices
+  //
+  std::vector<std::vector<int> > unit(_slot.size());
+
+  for(int s = 0; s < _slot.size(); ++s) {
+    //
+    const int at [2] = {_atom[s].first, _atom[s].second};
+
+    for(int k = std::min(_cap[at[0]], _cap[at[1]]); k > 0; --k, n += 2) {
+      //
+      unit[s].push_back(n);
+
+      adj.resize(n + 2);
+
+      adj[n].push_back(n + 1);
+
+      adj[n + 1].push_back(n);
+
+      for(int i = 0; i < 2; ++i)
+	//
+	for(int c = copy[at[i]]; c < copy[at[i]] + _cap[at[i]]; ++c) {
+	  //
+	  adj[n + i].push_back(c);
+
+	  adj[c].push_back(n + i);
+	}
+    }
+  }
+
+  std::vector<int> mate;
+
+  max_matching(adj, mate);
+
+  for(int s = 0; s < _slot.size(); ++s) {
+    //
+    int x = 0;
+
+    for(std::vector<int>::const_iterator u = unit[s].begin(); u != unit[s].end(); ++u)
+      //
+      if(mate[*u] >= 0 && mate[*u] != *u + 1 && mate[*u + 1] >= 0)
+	//
+	++x;
+
+    _target += x;
+
+    if(x)
+      //
+      _max_res.push_back(std::make_pair(_slot[s], (unsigned char)x));
+  }
+
+  std::sort(_max_res.begin(), _max_res.end());
+}
+
+// place pi bonds on the next slot
+//
+void MolecStruct::ResonanceGenerator::_push (int x)
+{
+  const int at [2] = {_atom[_pos].first, _atom[_pos].second};
+
+  _count[_pos++] = x;
+
+  _total += x;
+    
+  for(int i = 0; i < 2; ++i) {
+    //
+    _cap[at[i]] -= x;
+
+    _free -= x;
+
+    // no more slots for the atom
+    //
+    if(!--_left[at[i]])
+      //
+      _free -= _cap[at[i]];
+  }
+}
+
+// remove pi bonds from the last assigned slot
+//
+int MolecStruct::ResonanceGenerator::_pop ()
+{
+  const int x = _count[--_pos];
+
+  const int at [2] = {_atom[_pos].first, _atom[_pos].second};
+
+  for(int i = 0; i < 2; ++i) {
+    //
+    if(!_left[at[i]]++)
+      //
+      _free += _cap[at[i]];
+
+    _free += x;
+
+    _cap[at[i]] += x;
+  }
+
+  _total -= x;
+
+  _count[_pos] = 0;
+
+  return x;
+}
+
+// go down the search tree to the first complete placement with the target number of pi bonds
+//
+bool MolecStruct::ResonanceGenerator::_search ()
+{
+  while(1) {
+    //
+    if(!(++_node & 4095) && resonance_time_over(_start)) {
+      //
+      _timeout = true;
+
+      return false;
+    }
+
+    // the target cannot be reached
+    //
+    if(_total + _free / 2 < _target) {
+      //
+      if(!_retreat())
+	//
+	return false;
+
+      continue;
+    }
+
+    if(_pos == _slot.size())
+      //
+      return true;
+
+    _push(std::min(_cap[_atom[_pos].first], _cap[_atom[_pos].second]));
+  }
+}
+
+// go to the next branch of the search tree
+//
+bool MolecStruct::ResonanceGenerator::_retreat ()
+{
+  while(_pos) {
+    //
+    const int x = _pop();
+
+    if(x) {
+      //
+      _push(x - 1);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool MolecStruct::ResonanceGenerator::next (Resonance& res)
+{
+  if(2 == _state)
+    //
+    return false;
+
+  if(!(_state++ ? _retreat() && _search() : _search())) {
+    //
+    _state = 2;
+
+    return false;
+  }
+
+  _state = 1;
+  
+  res.clear();
+
+  for(int s = 0; s < _slot.size(); ++s)
+    //
+    if(_count[s])
+      //
+      res.push_back(std::make_pair(_slot[s], (unsigned char)_count[s]));
+
+  std::sort(res.begin(), res.end());
+
+  return true;
+}
+
+// number of the pi bonds added to the sigma bond in the resonance
+//
+int MolecStruct::_increment (const Resonance& res, int b)
+{
+  Resonance::const_iterator it = std::lower_bound(res.begin(), res.end(), std::make_pair(b, (unsigned char)0));
+
+  if(it != res.end() && it->first == b)
+    //
+    return it->second;
+
+  return 0;
+}
+
+// check if the bond is single
+//
+bool MolecStruct::is_single (int at0, int at1) const 
+{
+  const char funame [] = "MolecStruct::is_single: "; 
+
+  if(!is_connected(at0, at1)) {
+    //
+    std::cerr << funame << "no bond";
+
+    throw Error::Logic();
+  }
+
+  return _single(at0, at1);
+}
+
+// check if the site is a radical one
+bool MolecStruct::is_radical (int at) const
+{
+  return _radical[at];
+}
+
+BetaData MolecStruct::is_beta (int at0, int at1) const 
+{
+  // is the bond single one
+  //
+  BetaData res;
+  
+  if(!is_single(at0, at1))
+    //
+    return res;
+
+  // does the bond belong to a ring structure
+  //
+  if(is_ring(at0, at1))
+    //
+    res.isring = true;
+
+  // find if there is a radical site next to the bond: the atoms bonded to
+  // either end in ascending order
+  //
+  const ConList& adj = adjacency();
+
+  std::vector<int> next(adj.degree(at0) + adj.degree(at1));
+
+  std::merge(adj.begin(at0), adj.end(at0), adj.begin(at1), adj.end(at1), next.begin());
+
+  for(std::vector<int>::const_iterator nit = next.begin(); nit != next.end(); ++nit) {
+    //
+    const int rad = *nit;
+    
+    if(rad == at0 || rad == at1)
+      //
+      continue;
+    
+    if(!is_radical(rad))
+      //
+      continue;
+    
+    if(is_connected(rad, at0)) {
+      //
+      res.radical = rad;
+
+      res.primary = at0;
+
+      res.secondary = at1;
+
+      return res;
+    }
+    
+    if(is_connected(rad, at1)) {
+      //
+      res.radical = rad;
+
+      res.primary = at1;
+
+      res.secondary = at0;
+
+      return res;
+    }
+  }
+  
+  return res;
+}
+
+double MolecStruct::bond_order (int i, int j) const
+{
+  return _bond_order(i, j);
+}
+
+const char* MolecStruct::var_name (int v)
+{
+  const char funame [] = "MolecStruct::var_name: ";
+
+  if(DISTANCE == v)
+    return "R";
+
+  if(POLAR == v)
+    return "A";
+  
+  if(DIHEDRAL == v)
+    return "D";
+  
+  std::cerr << funame << "out of range\n";
+  throw Error::Range();
+}
+
+RotorScan::RotorScan (const MolecStruct& mol, const std::vector<std::vector<double> >& grid, bool unique)
+  : _mol(mol), _grid(grid), _point(grid.size(), 0), _end(false), _unique(unique && mol.size() > 1), _skipped(0)
+{
+  const char funame [] = "RotorScan::RotorScan: ";
+
+  if(_grid.size() != mol.rotation_bond().size()) {
+    //
+    std::cerr << funame << "wrong number of rotors: " << _grid.size() << "\n";
+
+    throw Error::Range();
+  }
+
+  for(int r = 0; r < _grid.size(); ++r)
+    //
+    if(!_grid[r].size()) {
+      //
+      std::cerr << funame << r << "-th rotor: empty grid\n";
+
+      throw Error::Range();
+    }
+
+  const std::vector<int>& zvar = mol.zmat_var();
+
+  for(int v = 0; v < zvar.size(); ++v)
+    //
+    _var.push_back(mol.zmat_coval()(zvar[v] % 3, zvar[v] / 3));
+
+  for(std::map<int, std::list<std::list<int> > >::const_iterator bit = mol.rotation_bond().begin();
+      bit != mol.rotation_bond().end(); ++bit)
+    //
+    _column.push_back(std::find(zvar.begin(), zvar.end(), MolecStruct::DIHEDRAL + 3 * bit->first) - zvar.begin());
+
+  if(_unique)
+    //
+    _set_move();
+}
+
+// index of the grid increment equal to the given one modulo 360 degrees, -1 if there is none
+//
+int grid_index (const std::vector<double>& grid, double incr)
+{
+  for(int i = 0; i < grid.size(); ++i) {
+    //
+    double d = std::fmod(grid[i] - incr, 360.);
+
+    if(d < 0.)
+      //
+      d += 360.;
+
+    if(d < 1.e-6 || d > 360. - 1.e-6)
+      //
+      return i;
+  }
+
+  return -1;
+}
+
+// the largest n not exceeding six such that the atoms group goes to itself by the 360/n degrees
+// rotation around the at0-at1 axis
+//
+int torsional_periodicity (const MolecGeom& g, const std::list<int>& group, int at0, int at1)
+{
+  D3::Vector axis = g[at1] - g[at0];
+
+  axis.normalize();
+
+  for(int n = 6; n > 1; --n) {
+    //
+    const double cs = std::cos(2. * M_PI / n);
+    const double sn = std::sin(2. * M_PI / n);
+
+    bool sym = true;
+
+    for(std::list<int>::const_iterator a = group.begin(); sym && a != group.end(); ++a) {
+      //
+      D3::Vector r = g[*a] - g[at0];
+
+      const D3::Vector par = axis * vdot(axis, r);
+
+      r -= par;
+
+      const D3::Vector pos = g[at0] + par + r * cs + vprod(axis, r) * sn;
+
+      sym = false;
+
+      for(std::list<int>::const_iterator b = group.begin(); b != group.end(); ++b)
+	//
+	if(g[*b] == g[*a] && vdistance(g[*b], pos) < distance_tolerance) {
+	  //
+	  sym = true;
+
+	  break;
+	}
+    }
+
+    if(sym)
+      //
+      return n;
+  }
+
+  return 1;
 }
 
-void MolecStruct::print (std::ostream& to, const std::string& offset) const
+// grid points maps by the proper rotations of the reference geometry, which permute the rotors
+// keeping the dihedral angles increments, and by the torsional periodicity of the rotating
+// groups which are not changed by the other rotors
+//
+void RotorScan::_set_move ()
 {
-  const PrimStruct& m = *this;
-  
-  double dtemp;
-  bool   btemp;
-  int    itemp;
-
-  int old_precision = to.precision(2);
-
-  to << offset << "Molecular structure:";
+  const int nrot = _grid.size();
 
-  if(_resonance.size() > 1) {
+  if(!nrot)
     //
-    to << " resonantly stabilized (" << _resonance.size() << " resonances)" ;
-  }
+    return;
 
-  to << "\n\n"; 
+  // reference geometry
+  //
+  std::vector<double> xyz(3 * _mol.size());
 
-  to << offset << "   A\\A  ";
+  _mol.zmat_cartesian(1, _var.data(), xyz.data());
 
-  for(int i = 0; i < size(); ++i) {
+  MolecGeom ref(_mol.size());
+
+  for(int a = 0; a < _mol.size(); ++a) {
     //
-    to << std::setw(3) <<  atom_name(i);
+    ref[a] = _mol[a];
 
-    if(i < 9) {
-      //
-      to << i + 1 << " ";
-    }
-    else
+    for(int i = 0; i < 3; ++i)
       //
-      to << i + 1;
+      ref[a][i] = xyz[3 * a + i];
   }
 
-  to << "\n\n";
+  // rotational bonds and the rotating groups
+  //
+  std::vector<std::set<int> > bond;
 
-  for(int j = 0; j < size(); ++j) {
+  std::vector<std::list<std::list<int> > > group;
+
+  for(std::map<int, std::list<std::list<int> > >::const_iterator bit = _mol.rotation_bond().begin();
+      bit != _mol.rotation_bond().end(); ++bit) {
     //
-    to << offset << std::setw(4) << atom_name(j);
+    group.push_back(bit->second);
 
-    if(j < 9) {
-      //
-      to << j + 1 << " ";
-    }
-    else
-      //
-      to << j + 1;
+    std::set<int> b;
 
-    for(int i = 0; i < j; ++i) {
+    for(std::list<std::list<int> >::const_iterator git = bit->second.begin(); git != bit->second.end(); ++git)
       //
-      to << std::setw(5) << bond_order(i, j);
-    }
+      b.insert(git->front());
 
-    to << std::setw(5) << "X" << "\n\n";
+    bond.push_back(b);
   }
 
-  to << "\n";
+  // proper rotations, the identity excluded
+  //
+  const MolecOrient mo(ref);
 
-  std::vector<int> rs_vec;
+  const std::vector<MolecOrient::SymOp>& op = mo.sym_ops();
 
-  for(int rad = 0; rad < size(); ++rad) {
+  for(int o = 1; o < op.size(); ++o) {
     //
-    btemp = false;
+    GridMove move;
 
-    for(int r = 0; r < _resonance.size(); ++r) {
+    for(int r = 0; r < nrot; ++r) {
       //
-      if(_resonance[r].row_sum(rad) < 2 * valence(rad)) {
+      std::set<int> b;
+
+      for(std::set<int>::const_iterator it = bond[r].begin(); it != bond[r].end(); ++it)
 	//
-	btemp = true;
+	b.insert(op[o].perm[*it]);
 
+      const int q = std::find(bond.begin(), bond.end(), b) - bond.begin();
+
+      if(q == nrot)
+	//
 	break;
-      }
-    }
 
-    if(btemp)
-      //
-      rs_vec.push_back(rad);
-  }
+      move.rotor.push_back(q);
 
-  if(rs_vec.size() > 1) {
-    to << offset << "Free radical: Radical sites are ";
-    for(int i = 0; i < rs_vec.size(); ++i) {
-      itemp = rs_vec[i];
-      to << atom_name(itemp) << itemp + 1 << " ";
+      move.index.push_back(std::vector<int>(_grid[r].size()));
+
+      for(int i = 0; i < _grid[r].size(); ++i)
+	//
+	move.index.back()[i] = grid_index(_grid[q], _grid[r][i]);
     }
-  }
-  else if(rs_vec.size() == 1) {
-    itemp = rs_vec[0];
-    to << offset << "Free radical: Radical site is "
-       << atom_name(itemp) << itemp + 1 << " ";
-  }
-  to << "\n\n";
 
-  to << "Z-Matrix atom order:\n";
+    if(move.rotor.size() == nrot)
+      //
+      _move.push_back(move);
+  }
 
-  for(int i = 0; i < _cpath.size(); ++i) {
+  // torsional periodicity shifts
+  //
+  for(int r = 0; r < nrot; ++r)
     //
-    to << std::setw(2) << i + 1 << " --> " << std::setw(2);
-
-    if(_cpath[i].atom < 0) {
+    for(std::list<std::list<int> >::const_iterator git = group[r].begin(); git != group[r].end(); ++git) {
       //
-      to << "X";
-    }
-    else
+      // the group containing another rotational bond changes its shape during the scan
       //
-      to << _cpath[i].atom + 1;
-    
-    to << "\n";
-  }
+      bool rigid = true;
 
-  to << "\n";
-  
-  to.precision(old_precision);
-}
+      for(int q = 0; q < nrot; ++q) {
+	//
+	int count = 0;
 
-std::vector<int> MolecStruct::atom_ordering() const
-{
-  unsigned int n = _cpath.size();
-  std::vector<int> order(n);
+	for(std::list<int>::const_iterator it = git->begin(); it != git->end(); ++it)
+	  //
+	  count += bond[q].count(*it);
 
-  for(unsigned int i = 0; i < n; ++i)
-    order[i] = _cpath[i].atom;
+	if(q != r && count == 2)
+	  //
+	  rigid = false;
+      }
 
-  return order;
+      if(!rigid)
+	//
+	continue;
+
+      const int at0 = git->front();
+
+      const int at1 = *bond[r].begin() == at0 ? *bond[r].rbegin() : *bond[r].begin();
+
+      const int n = torsional_periodicity(ref, *git, at0, at1);
+
+      for(int sign = 1; n > 1 && sign > -3; sign -= 2) {
+	//
+	GridMove move;
+
+	for(int q = 0; q < nrot; ++q) {
+	  //
+	  move.rotor.push_back(q);
+
+	  move.index.push_back(std::vector<int>(_grid[q].size()));
+
+	  for(int i = 0; i < _grid[q].size(); ++i)
+	    //
+	    move.index.back()[i] = q == r ? grid_index(_grid[q], _grid[q][i] + sign * 360. / n) : i;
+	}
+
+	_move.push_back(move);
+      }
+    }
 }
 
-// check if the bond is single
+// the grid points equivalent to the given one are generated breadth first; the scan order
+// is the one of the grid point counter, the first rotor index changing fastest
 //
-bool MolecStruct::is_single (int at0, int at1) const 
+bool RotorScan::_is_canonical (const std::vector<int>& point) const
 {
-  const char funame [] = "MolecStruct::is_single: "; 
+  std::set<std::vector<int> > orbit;
 
-  if(!is_connected(at0, at1)) {
-    //
-    std::cerr << funame << "no bond";
+  orbit.insert(point);
 
-    throw Error::Logic();
-  }
+  std::vector<std::vector<int> > queue(1, point);
 
-  for(int r = 0; r < _resonance.size(); ++r)
+  std::vector<int> next(point.size());
+
+  for(int p = 0; p < queue.size(); ++p)
     //
-    if(_resonance[r](at0, at1) > 2)
+    for(std::vector<GridMove>::const_iterator mit = _move.begin(); mit != _move.end(); ++mit) {
       //
-      return false;
+      int r;
+
+      for(r = 0; r < point.size(); ++r)
+	//
+	if((next[mit->rotor[r]] = mit->index[r][queue[p][r]]) < 0)
+	  //
+	  break;
+
+      if(r < point.size() || !orbit.insert(next).second)
+	//
+	continue;
+
+      if(std::lexicographical_compare(next.rbegin(), next.rend(), point.rbegin(), point.rend()))
+	//
+	return false;
+
+      queue.push_back(next);
+    }
 
   return true;
 }
 
-// check if the site is a radical one
-bool MolecStruct::is_radical (int at) const
+// is the geometry superimposable with one of the geometries found; the geometries are compared
+// by the sorted interatomic distances at the fixed ranks first, those equal within the distance
+// tolerance have the distances quantized by the tolerance in the same or the neighboring cells
+// at the hash key ranks
+//
+bool RotorScan::_is_found (const MolecGeom& geom)
 {
-  for(int r = 0; r < _resonance.size(); ++r)
+  // sorted interatomic distances
+  //
+  std::vector<double> dist;
+
+  for(int i = 0; i < geom.size(); ++i)
     //
-    if(_resonance[r].row_sum(at) < 2 * valence(at))
+    for(int j = 0; j < i; ++j)
       //
-      return true;
+      dist.push_back((geom[i] - geom[j]).vlength());
 
-  return false;
-}
+  std::sort(dist.begin(), dist.end());
 
-BetaData MolecStruct::is_beta (int at0, int at1) const 
-{
-  // is the bond single one
-  //
-  BetaData res;
-  
-  if(!is_single(at0, at1))
+  const int nrank = 16;
+
+  const int nkey = 4;
+
+  std::vector<double> fp(nrank);
+
+  for(int k = 0; k < nrank; ++k)
     //
-    return res;
+    fp[k] = dist[(dist.size() - 1) * (k + 1) / nrank];
 
-  // does the bond belong to a ring structure
-  //
-  if(is_ring(at0, at1))
+  std::vector<long> key(nkey);
+
+  for(int k = 0; k < nkey; ++k)
     //
-    res.isring = true;
+    key[k] = (long)std::floor(fp[nrank - 1 - k * nrank / nkey] / distance_tolerance);
+
+  std::vector<long> cell(nkey);
+
+  int ncell = 1;
 
-  // find if there is a radical site next to the bond
+  for(int k = 0; k < nkey; ++k)
+    //
+    ncell *= 3;
+
+  // geometries found in the neighboring cells with the same distances at the fixed ranks
   //
-  for(int rad = 0; rad < size(); ++rad) {
+  std::vector<int> cand;
+
+  for(int c = 0; c < ncell; ++c) {
     //
-    if(rad == at0 || rad == at1)
+    for(int k = 0, i = c; k < nkey; ++k, i /= 3)
       //
-      continue;
-    
-    if(!is_radical(rad))
+      cell[k] = key[k] + i % 3 - 1;
+
+    std::map<std::vector<long>, std::vector<int> >::const_iterator kit = _found_key.find(cell);
+
+    if(kit == _found_key.end())
       //
       continue;
-    
-    if(is_connected(rad, at0)) {
-      //
-      res.radical = rad;
 
-      res.primary = at0;
+    for(std::vector<int>::const_iterator g = kit->second.begin(); g != kit->second.end(); ++g) {
+      //
+      int k;
 
-      res.secondary = at1;
+      for(k = 0; k < nrank; ++k)
+	//
+	if(!are_distances_equal(fp[k], _fp[*g][k]))
+	  //
+	  break;
 
-      return res;
+      if(k == nrank)
+	//
+	cand.push_back(*g);
     }
-    
-    if(is_connected(rad, at1)) {
+  }
+
+  if(cand.size()) {
+    //
+    const MolecOrient mo(geom);
+
+    for(std::vector<int>::const_iterator g = cand.begin(); g != cand.end(); ++g)
       //
-      res.radical = rad;
+      if(compare(MolecOrient(_found[*g]), mo, MolecOrient::TEST))
+	//
+	return true;
+  }
 
-      res.primary = at1;
+  _found_key[key].push_back(_found.size());
 
-      res.secondary = at0;
+  _found.push_back(geom);
 
-      return res;
-    }
-  }
-  
-  return res;
+  _fp.push_back(fp);
+
+  return false;
 }
 
-double MolecStruct::bond_order (int i, int j) const
+bool RotorScan::next (MolecGeom& geom, std::vector<double>& incr)
 {
-  if(!(*this)(i,j))
+  std::vector<double> var(_var.size());
+
+  std::vector<double> xyz(3 * _mol.size());
+
+  while(!_end) {
     //
-    return 0.;
+    const std::vector<int> point = _point;
+
+    var = _var;
 
-  double res = 0.;
+    incr.resize(_grid.size());
 
-  for(int r = 0; r < _resonance.size(); ++r)
+    for(int r = 0; r < _grid.size(); ++r) {
+      //
+      incr[r] = _grid[r][_point[r]];
+
+      var[_column[r]] = std::fmod(var[_column[r]] + incr[r], 360.);
+
+      if(var[_column[r]] < 0.)
+	//
+	var[_column[r]] += 360.;
+    }
+
+    // next grid point
     //
-    res += (double)_resonance[r](i, j);
+    int r;
 
-  res /= (double)_resonance.size() * 2.;
+    for(r = 0; r < _grid.size(); ++r)
+      //
+      if(++_point[r] < _grid[r].size())
+	//
+	break;
+      else
+	//
+	_point[r] = 0;
 
-  return res;
-}
+    if(r == _grid.size())
+      //
+      _end = true;
 
-const char* MolecStruct::var_name (int v)
-{
-  const char funame [] = "MolecStruct::var_name: ";
+    if(_unique && !_is_canonical(point)) {
+      //
+      ++_skipped;
 
-  if(DISTANCE == v)
-    return "R";
+      continue;
+    }
 
-  if(POLAR == v)
-    return "A";
-  
-  if(DIHEDRAL == v)
-    return "D";
-  
-  std::cerr << funame << "out of range\n";
-  throw Error::Range();
-}
+    _mol.zmat_cartesian(1, var.data(), xyz.data());
+
+    geom.resize(_mol.size());
 
+    for(int a = 0; a < _mol.size(); ++a) {
+      //
+      geom[a] = _mol[a];
+
+      for(int i = 0; i < 3; ++i)
+	//
+	geom[a][i] = xyz[3 * a + i];
+    }
+
+    if(_unique && _is_found(geom)) {
+      //
+      ++_skipped;
+
+      continue;
+    }
+
+    return true;
+  }
+
+  return false;
+}
@@ -12,11 +12,27 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <chrono>
 
 /*********************** Atomic coordinates accuracies *******************/
 
 extern double angle_tolerance, distance_tolerance;
 
+// resonances enumeration methods: maximal pi bond placements or breadth-first bond increment
+//
+enum resonance_method_t { RESONANCE_MATCHING, RESONANCE_BFS };
+
+extern resonance_method_t resonance_method;
+
+// resonances enumeration limits: the number of resonances and the time [sec]; zero means no limit;
+// with the breadth-first method the number limit caps only the resonances the statistics are
+// accumulated over, the bond increment generations are kept in full, and it is the time limit
+// which bounds the enumeration time and memory
+//
+extern int    resonance_limit;
+extern double resonance_time_limit;
+
 bool are_angles_equal (double, double);
 
 bool are_distances_equal (double, double);
@@ -42,6 +58,70 @@ public:
   void operator -= (const D3::Vector&);
 }; 
 
+// rotation-invariant atomic signature: atom type and sorted distances to the other atoms
+//
+class AtomSignature : private std::vector<std::pair<AtomBase, double> > {
+  //
+  AtomBase _atom;
+
+public:
+  //
+  AtomSignature (const MolecGeom&, int);
+
+  // are the signatures the same within given distance tolerance
+  //
+  bool match (const AtomSignature&, double) const;
+};
+
+// spatial hash of atomic positions keyed by atom type (for the typed grid) and
+// quantized coordinates
+//
+class AtomGrid {
+  //
+  struct Key {
+    //
+    int  atom;
+    int  isot;
+    long cell [3];
+
+    bool operator== (const Key&) const;
+  };
+
+  struct KeyHash {
+    //
+    std::size_t operator() (const Key&) const;
+  };
+
+  typedef std::unordered_map<Key, std::vector<int>, KeyHash> _map_t;
+
+  _map_t _map;
+
+  double _cell; // cell size
+
+  bool _typed; // are the atoms sorted by type
+
+  Key _key (const AtomBase&, const double*) const;
+
+  void _find (const Key&, std::vector<int>&) const;
+
+public:
+  //
+  AtomGrid () : _cell(1.), _typed(true) {}
+  
+  AtomGrid (const MolecGeom&, double, bool typed = true);
+
+  double cell_size () const { return _cell; }
+
+  // atoms of the given type in the cells neighboring the position (all atoms
+  // within the cell size distance from the position are included)
+  //
+  void find (const AtomBase&, const double*, std::vector<int>&) const;
+
+  // all atoms in the cells neighboring the position (untyped grid)
+  //
+  void find (const double*, std::vector<int>&) const;
+};
+
 // molecule oriented and useful molecular properties
 //
 class MolecOrient : private MolecGeom {
@@ -52,20 +132,115 @@ public:
   
   enum mode_t { SYMNUM, TEST}; // calculation types
 
+  enum engine_t { GEOMETRIC, GRAPH }; // symmetry number engines
+
+  enum top_t { SPHERICAL_TOP, SYMMETRIC_TOP, ASYMMETRIC_TOP }; // rotor types
+
+  // symmetry operation in the input geometry terms: the atom i is moved to the position
+  // of the atom perm[i], and the positions relative to the center of mass are rotated
+  // as r' = rot * r
+  //
+  struct SymOp {
+    //
+    std::vector<int> perm;
+    
+    D3::Matrix rot;
+
+    bool proper; // proper rotation or rotation-reflection
+
+    int order () const; // rotation order (the rotation part for rotation-reflections)
+  };
+  
 private:
   //
   MT _mt; // molecule type
   
   double _dm [3]; // distance matrix of first three atoms
 
+  engine_t _engine; // symmetry number engine
+
+  top_t _top; // rotor type
+
+  double _pm [3]; // principal moments of inertia in ascending order
+
+  double _pm_tol; // principal moments uncertainty due to the distance tolerance
+
+  D3::Matrix _pa; // principal axes (rows)
+
+  D3::Vector _com; // center of mass
+
+  std::vector<int> _index; // input geometry index of the oriented atom
+
+  D3::Matrix _orient; // standard orientation axes (rows) in the input geometry frame
+  
+  // symmetry operations cache
+  //
+  mutable std::vector<SymOp> _ops;  // proper rotations
+  mutable std::vector<SymOp> _iops; // rotation-reflections
+
+  mutable bool _ops_done;
+  mutable bool _iops_done;
+
+  // atom permutations of the proper rotations found by the reference frames search,
+  // shared by sym_num and sym_ops
+  //
+  mutable std::vector<std::vector<int> > _perm;
+
+  mutable bool _perm_done;
+
+  const std::vector<std::vector<int> >& _proper_perm () const;
+
+  // orientation invariants cache
+  //
+  mutable std::vector<AtomSignature> _sig; // atomic signatures
+
+  mutable MolecGeom _image; // mirror image
+
+  mutable AtomGrid _grid [2]; // spatial hash of the geometry and of its mirror image
+
+  mutable bool _grid_done [2];
+
+  const std::vector<AtomSignature>& _signatures () const;
+
+  const MolecGeom& _geometry  (bool mirror) const;
+  const AtomGrid&  _atom_grid (bool mirror) const;
+
+  int _frame_search (const MolecOrient&, bool mirror, mode_t, std::vector<std::vector<int> >* =0) const;
+
+  void _set_inertia ();
+
+  SymOp _sym_op (const std::vector<int>&, const D3::Matrix&, bool) const;
+
+  int _axes_search   (std::vector<std::vector<int> >* =0) const;
+  int _graph_sym_num () const;
+
 public:
   //
   MolecOrient (const MolecGeom&);
   
   operator MolecGeom () const { return *this; }
 
+  void     set_engine (engine_t e) { _engine = e; }
+  engine_t engine     ()     const { return _engine; }
+
+  top_t             top              ()      const { return _top; }
+  double            principal_moment (int i) const { return _pm[i]; }
+  const D3::Matrix& principal_axes   ()      const { return _pa; }
+
   int  sym_num       () const ;
   bool is_enantiomer () const ;
+
+  // symmetry operations found by the same reference frames search as sym_num:
+  // proper rotations (the identity first) and rotation-reflections; for linear
+  // molecules only the representative operations are given
+  //
+  const std::vector<SymOp>& sym_ops      () const;
+  const std::vector<SymOp>& improper_ops () const;
+
+  // Schoenflies point group symbol, e.g. C2v, D6h, Td, Dinfh
+  //
+  std::string point_group () const;
+
   bool is_plane  () const { return _mt == PLANE; }
   bool is_linear () const { return _mt == LINEAR; }
 
@@ -79,13 +254,42 @@ int compare (const MolecOrient&, const MolecOrient&, MolecOrient::mode_t);
 
 // connection graph
 //
-class PrimStruct : public ConMat<unsigned>, private MolecGeom {
+class PrimStruct : public ConMat<bool>, private MolecGeom {
   //
   std::vector<bool> _la; // linear attribute
+
+  // adjacency list, connected groups, and bridges (bonds which are not in a ring)
+  // caches, invalidated by the connectivity change
+  //
+  mutable ConList _adj;
+
+  mutable bool _adj_done;
+  
+  mutable std::list<std::list<int> > _group;
+
+  mutable bool _group_done;
+
+  mutable ConMat<bool> _bridge;
+
+  mutable bool _bridge_done;
+
+  void _set_bridge () const;
+
+  void _frontier_group (std::list<std::list<int> >&, int = -1, int = -1) const;
   
 public:
   //
   PrimStruct (const MolecGeom&, const std::set<std::set<int> >&);
+
+  bool                    operator() (int i, int j) const { return ConMat<bool>::operator()(i, j); }
+  ConMat<bool>::reference operator() (int i, int j)       { _adj_done = _group_done = _bridge_done = false; return ConMat<bool>::operator()(i, j); }
+
+  // bonded atoms in ascending order
+  //
+  const ConList& adjacency () const;
+
+  int degree (int i) const { return row_sum(i); }
+
   
   const Atom& operator [] (int i) const { return MolecGeom::operator[](i); }
 
@@ -99,9 +303,13 @@ public:
 
   bool is_connected (int, const std::list<int>&) const;
 
-  std::list<std::list<int> > connected_group () const;
+  const std::list<std::list<int> >& connected_group () const;
 
   bool is_connected () const { if(connected_group().size() == 1) return true; return false; }
+
+  // groups split by the bridge bond
+  //
+  std::list<std::list<int> > bridge_group (int, int) const;
   
   //int distance (int, int) const ;
   
@@ -153,7 +361,114 @@ struct BetaData {
 //
 class MolecStruct : public PrimStruct
 {
-  std::vector<ConMat<unsigned> > _resonance;
+  // bonds (i > j) in ascending order
+  //
+  std::vector<std::pair<int, int> > _bond;
+
+  // sigma framework bond orders (doubled): 2 for regular, 1 for incipient bonds
+  //
+  std::vector<unsigned char> _sigma;
+
+  // free valences (doubled) of the sigma framework
+  //
+  std::vector<int> _free_val;
+
+public:
+  //
+  // resonance: sparse list of the pi bonds added to the sigma framework, sorted by bond index
+  //
+  typedef std::vector<std::pair<int, unsigned char> > Resonance;
+
+  // lazy enumeration of the resonances as the maximal pi bond placements
+  //
+  class ResonanceGenerator {
+    //
+    std::vector<int> _slot; // bonds to place pi bonds on
+
+    std::vector<std::pair<int, int> > _atom; // the slots atoms
+
+    std::vector<int> _count; // pi bonds placed on each slot
+
+    std::vector<int> _cap; // remaining atomic pi bond capacities
+
+    std::vector<int> _left; // slots left for the atom
+
+    int _free; // remaining capacity of the atoms with slots left
+
+    int _total; // pi bonds placed
+
+    int _target; // pi bonds to place
+
+    int _pos; // slots assigned
+
+    int _state; // 0 - not started, 1 - running, 2 - done
+
+    Resonance _max_res; // maximal pi bond placement found by the matching
+
+    std::chrono::steady_clock::time_point _start; // enumeration start
+
+    long _node; // search tree nodes visited
+
+    bool _timeout; // stopped by the resonance_time_limit
+
+    void _set_target (const MolecStruct&);
+
+    void _push (int);
+    int  _pop  ();
+    bool _search  ();
+    bool _retreat ();
+    
+  public:
+    //
+    // the resonance_time_limit is counted from the given start
+    //
+    ResonanceGenerator (const MolecStruct&, std::chrono::steady_clock::time_point);
+
+    // next resonance; false if there are no more or the time is over
+    //
+    bool next (Resonance&);
+
+    int pi_bond_count () const { return _target; }
+
+    bool is_timeout () const { return _timeout; }
+
+    // one resonance, available without the search
+    //
+    const Resonance& max_resonance () const { return _max_res; }
+  };
+
+private:
+  //
+  static int _increment (const Resonance&, int);
+
+  // resonances enumeration
+  //
+  void _bfs_resonance      (std::chrono::steady_clock::time_point);
+  void _matching_resonance (std::chrono::steady_clock::time_point);
+
+  // resonances statistics accumulated over the enumeration
+  //
+  void _add_resonance (const Resonance&, std::vector<int>&);
+
+  int _resonance_count; // number of resonances
+
+  bool _resonance_truncated; // resonances enumeration stopped by the limits
+
+  std::vector<long long> _pi_sum; // pi bonds numbers summed over the resonances for each bond
+
+  std::vector<unsigned char> _pi_max; // the largest number of pi bonds for each bond
+
+  std::vector<bool> _radical; // atoms with free valence in some resonance
+
+  // resonance-averaged bond orders and single bonds tables
+  //
+  void _set_bond_tables ();
+
+  ConMat<double> _bond_order;
+
+  ConMat<bool> _single;
+
+  std::vector<int> _unsaturated; // atoms with free valence in the sigma framework
 
   std::vector<ConRec> _cpath; // connectivity scheme
   
@@ -165,6 +480,17 @@ class MolecStruct : public PrimStruct
   
   MultiArray<double>  _coval; // initial values of z-matrix coordinates
 
+  // atoms defining the z-matrix coordinates values, indexed as the constants; empty for
+  // the constants
+  //
+  std::vector<std::vector<int> > _coatom;
+
+  void _set_coval (int var, int ref0, int at0, int at1, int at2 = -1, int at3 = -1);
+
+  std::vector<int> _zvar; // z-matrix variables, indexed as the constants
+
+  std::vector<int> _zref; // z-matrix references, indexed as the constants
+
   std::list<int> _constvar; // constants
 
   std::map<int, int> _atom_map; // atom-to-zmatrix map
@@ -181,7 +507,13 @@ public:
 
   MolecStruct (const PrimStruct&, const std::set<std::set<int> >&) ;
 
-  int resonance_count () const { return _resonance.size(); }
+  int resonance_count () const { return _resonance_count; }
+
+  // resonances enumeration stopped by the resonance_limit or resonance_time_limit
+  //
+  bool is_resonance_truncated () const { return _resonance_truncated; }
+
+  const std::pair<int, int>& bond (int b) const { return _bond[b]; }
 
   std::vector<int> atom_ordering() const;
  
@@ -204,7 +536,93 @@ public:
 
   const MultiArray<double>&          zmat_coval () const { return _coval; }
 
+  // recompute the z-matrix coordinates values for the new geometry with the same atom ordering;
+  // the stored Cartesian geometry (operator[]) is left at the old positions
+  //
+  void update_zmat_coval (const ::MolecGeom&);
+
+  // z-matrix variables (not constants) in the z-matrix order, indexed as the constants
+  //
+  const std::vector<int>& zmat_var () const { return _zvar; }
+
+  // z-matrix variables values for the trajectory: nframe x size() x 3 positions to
+  // nframe x zmat_var().size() table
+  //
+  void zmat_trajectory (int nframe, const double* xyz, double* table) const;
+
+  // Cartesian coordinates for the z-matrix variables sets: nset x zmat_var().size()
+  // table to nset x size() x 3 positions; the constants are taken from zmat_coval()
+  //
+  void zmat_cartesian (int nset, const double* var, double* xyz) const;
+
   int atom_map (int i) const;
 };
 
+// rotor scan: the geometries on the grid of the rotational bond dihedral angles increments,
+// generated one at a time; the grid points superimposable by a rotation with the ones
+// already generated are skipped
+//
+class RotorScan {
+  //
+  const MolecStruct& _mol;
+
+  std::vector<std::vector<double> > _grid; // dihedral angles increments [deg] for each rotor
+
+  std::vector<int> _column; // rotors dihedral angles columns in the z-matrix variables
+
+  std::vector<double> _var; // reference z-matrix variables values
+
+  std::vector<int> _point; // current grid point
+
+  bool _end;
+
+  bool _unique;
+
+  int _skipped;
+
+  // grid points map by the reference geometry symmetry: the grid point p goes to the
+  // equivalent one q, q[rotor[r]] = index[r][p[r]], if all the indices are non-negative
+  //
+  struct GridMove {
+    //
+    std::vector<int> rotor;
+
+    std::vector<std::vector<int> > index;
+  };
+
+  // proper rotations of the reference geometry and the rotors torsional periodicity
+  // shifts
+  //
+  std::vector<GridMove> _move;
+
+  void _set_move ();
+
+  // no equivalent grid point comes earlier in the scan order
+  //
+  bool _is_canonical (const std::vector<int>&) const;
+
+  // distinct geometries generated, their sorted interatomic distances at the fixed ranks,
+  // and the geometries hashed by these distances quantized
+  //
+  std::vector<MolecGeom> _found;
+
+  std::vector<std::vector<double> > _fp;
+
+  std::map<std::vector<long>, std::vector<int> > _found_key;
+
+  bool _is_found (const MolecGeom&);
+
+public:
+  //
+  // increments grid for each rotation_bond() dihedral angle, in the map order
+  //
+  RotorScan (const MolecStruct&, const std::vector<std::vector<double> >&, bool unique = true);
+
+  // next grid point geometry and the dihedral angles increments; false if there are no more
+  //
+  bool next (MolecGeom&, std::vector<double>&);
+
+  int skipped () const { return _skipped; }
+};
+
 #endif
@@ -1,5 +1,7 @@
 #include "d3.hh"
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 /*********************** 3-D reference frame ***********************/
 
@@ -419,3 +421,85 @@ double vol (const D3::Vector& a1, const D3::Vector& a2, const D3::Vector& a3)
   return vdot(vprod(a1, a2), a3);
 }
 
+
+// cyclic Jacobi rotations
+//
+void diagonalize (const D3::Matrix& m, double* eval, D3::Matrix& evec)
+{
+  const char funame [] = "diagonalize: ";
+
+  static const int    max_sweep = 50;
+  static const double tol = 1.e-15;
+
+  D3::Matrix a = m;
+
+  for(int i = 0; i < 3; ++i)
+    for(int j = 0; j < 3; ++j)
+      evec(i, j) = i == j ? 1. : 0.;
+
+  int sweep;
+  for(sweep = 0; sweep < max_sweep; ++sweep) {
+    double off = 0., diag = 0.;
+    for(int i = 0; i < 3; ++i) {
+      diag += a(i, i) * a(i, i);
+      for(int j = i + 1; j < 3; ++j)
+	off += a(i, j) * a(i, j);
+    }
+
+    if(off <= tol * tol * diag)
+      break;
+
+    for(int p = 0; p < 3; ++p)
+      for(int q = p + 1; q < 3; ++q) {
+	if(a(p, q) == 0.)
+	  continue;
+
+	// rotation angle
+	const double theta = (a(q, q) - a(p, p)) / (2. * a(p, q));
+	double t = 1. / (std::fabs(theta) + std::sqrt(theta * theta + 1.));
+	if(theta < 0.)
+	  t = -t;
+	const double c = 1. / std::sqrt(t * t + 1.);
+	const double s = t * c;
+
+	// a = J^T a J
+	for(int k = 0; k < 3; ++k) {
+	  const double akp = a(k, p);
+	  const double akq = a(k, q);
+	  a(k, p) = c * akp - s * akq;
+	  a(k, q) = s * akp + c * akq;
+	}
+	for(int k = 0; k < 3; ++k) {
+	  const double apk = a(p, k);
+	  const double aqk = a(q, k);
+	  a(p, k) = c * apk - s * aqk;
+	  a(q, k) = s * apk + c * aqk;
+	}
+
+	// eigenvectors as rows
+	for(int k = 0; k < 3; ++k) {
+	  const double vp = evec(p, k);
+	  const double vq = evec(q, k);
+	  evec(p, k) = c * vp - s * vq;
+	  evec(q, k) = s * vp + c * vq;
+	}
+      }
+  }
+
+  if(sweep == max_sweep) {
+    std::cerr << funame << "not converged\n";
+    throw Error::Run();
+  }
+
+  for(int i = 0; i < 3; ++i)
+    eval[i] = a(i, i);
+
+  // ascending order
+  for(int i = 0; i < 3; ++i)
+    for(int j = i + 1; j < 3; ++j)
+      if(eval[j] < eval[i]) {
+	std::swap(eval[i], eval[j]);
+	for(int k = 0; k < 3; ++k)
+	  std::swap(evec(i, k), evec(j, k));
+      }
+}
@@ -151,4 +151,7 @@ void find_orth(const double*, D3::Vector []); // get two vectors orthogonal to t
 
 double vol (const D3::Vector&, const D3::Vector&, const D3::Vector&);
 
+// eigenvalues (ascending order) and eigenvectors (matrix rows) of the symmetric matrix
+void diagonalize (const D3::Matrix&, double*, D3::Matrix&);
+
 #endif
@@ -8,6 +8,8 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <algorithm>
+#include <bitset>
 
 double angle (const D3::Vector&, const D3::Vector&, 
 	      const D3::Vector&); // polar angle
@@ -111,6 +113,206 @@ T& ConMat<T>::operator() (int i, int j)
   throw Error::Range();
 }
 
+// bit-packed boolean connectivity matrix: full symmetric rows of 64-bit words
+template <>
+class ConMat<bool>
+{
+  typedef unsigned long long _word_t;
+
+  int _dim;
+  int _size; // words per row
+
+  std::vector<_word_t> _data;
+
+  void _check (int, int) const;
+
+public:
+  // single element reference
+  class reference
+  {
+    _word_t* _w [2];
+    _word_t  _m [2];
+
+  public:
+    reference (_word_t* w0, _word_t m0, _word_t* w1, _word_t m1) { _w[0] = w0; _m[0] = m0; _w[1] = w1; _m[1] = m1; }
+
+    operator bool () const { return *_w[0] & _m[0]; }
+
+    reference& operator= (bool b)
+    {
+      for(int i = 0; i < 2; ++i)
+	if(b)
+	  *_w[i] |= _m[i];
+	else
+	  *_w[i] &= ~_m[i];
+      return *this;
+    }
+  };
+
+  explicit ConMat(int d) : _dim(d), _size((d + 63) / 64), _data(d * ((d + 63) / 64), 0) {}
+
+  bool      operator() (int i, int j) const { _check(i, j); return _data[i * _size + j / 64] >> (j % 64) & 1; }
+  reference operator() (int i, int j)
+  {
+    _check(i, j);
+    return reference(&_data[i * _size + j / 64], (_word_t)1 << (j % 64), &_data[j * _size + i / 64], (_word_t)1 << (i % 64));
+  }
+
+  bool operator== (const ConMat<bool>& cm) const { return _data == cm._data; }
+  bool operator!= (const ConMat<bool>& cm) const { return _data != cm._data; }
+
+  int size () const { return _dim; }
+
+  int sum     ()      const; // number of connections
+  int row_sum (int i) const; // number of connections of the vertex
+
+  // the lowest vertex connected to the vertex and above the given one, if any, otherwise -1
+  int next (int i, int j = -1) const;
+};
+
+inline void ConMat<bool>::_check (int i, int j) const
+{
+  const char funame [] = "ConMat<bool>::operator() (int, int): ";
+
+#ifdef DEBUG
+  if(i < 0 || i >= _dim) {
+    std::cout << funame << "first index, " << i << ", is out of range\n";
+    throw Error::Range();
+  }
+
+  if(j < 0 || j >= _dim) {
+    std::cout << funame << "second index, " << j << ", is out of range\n";
+    throw Error::Range();
+  }
+
+#endif
+
+  if(i == j) {
+    std::cout << funame << "indices should be different\n";
+    throw Error::Range();
+  }
+}
+
+inline int ConMat<bool>::row_sum (int i) const
+{
+  int res = 0;
+  for(int w = i * _size; w < (i + 1) * _size; ++w)
+    res += std::bitset<64>(_data[w]).count();
+  return res;
+}
+
+inline int ConMat<bool>::sum () const
+{
+  int res = 0;
+  for(int i = 0; i < _data.size(); ++i)
+    res += std::bitset<64>(_data[i]).count();
+  return res / 2;
+}
+
+inline int ConMat<bool>::next (int i, int j) const
+{
+  ++j;
+
+  for(int w = j / 64; w < _size; ++w) {
+    _word_t x = _data[i * _size + w];
+
+    if(w == j / 64)
+      x &= ~(_word_t)0 << (j % 64);
+
+    if(x)
+      // lowest bit position
+      return w * 64 + std::bitset<64>((x & (~x + 1)) - 1).count();
+  }
+
+  return -1;
+}
+
+// compressed sparse (CSR) adjacency list of the connectivity matrix: neighbors of
+// each vertex in ascending order
+class ConList
+{
+  std::vector<int> _start; // neighbors list offsets
+  std::vector<int> _list;  // neighbors
+
+public:
+  ConList () : _start(1, 0) {}
+
+  template <typename T>
+  explicit ConList (const ConMat<T>&);
+
+  explicit ConList (const std::vector<std::vector<int> >&);
+
+  explicit ConList (const ConMat<bool>&);
+
+  int size () const { return _start.size() - 1; }
+
+  int degree (int i) const { return _start[i + 1] - _start[i]; }
+
+  const int* begin (int i) const { return _list.data() + _start[i]; }
+  const int* end   (int i) const { return _list.data() + _start[i + 1]; }
+
+  // sum of the matrix elements in the row over the neighbors
+  template <typename T>
+  T row_sum (const ConMat<T>&, int) const;
+};
+
+template <typename T>
+ConList::ConList (const ConMat<T>& m) : _start(m.size() + 1, 0)
+{
+  for(int i = 0; i < m.size(); ++i)
+    for(int j = 0; j < i; ++j)
+      if(m(i, j)) {
+	++_start[i + 1];
+	++_start[j + 1];
+      }
+
+  for(int i = 0; i < m.size(); ++i)
+    _start[i + 1] += _start[i];
+
+  _list.resize(_start.back());
+
+  std::vector<int> pos(_start.begin(), _start.end() - 1);
+
+  for(int i = 0; i < m.size(); ++i)
+    for(int j = 0; j < m.size(); ++j)
+      if(j != i && m(i, j))
+	_list[pos[i]++] = j;
+}
+
+inline ConList::ConList (const std::vector<std::vector<int> >& neighbor) : _start(neighbor.size() + 1, 0)
+{
+  for(int i = 0; i < neighbor.size(); ++i)
+    _start[i + 1] = _start[i] + neighbor[i].size();
+
+  _list.reserve(_start.back());
+
+  for(int i = 0; i < neighbor.size(); ++i) {
+    _list.insert(_list.end(), neighbor[i].begin(), neighbor[i].end());
+    std::sort(_list.end() - neighbor[i].size(), _list.end());
+  }
+}
+
+inline ConList::ConList (const ConMat<bool>& m) : _start(m.size() + 1, 0)
+{
+  for(int i = 0; i < m.size(); ++i)
+    _start[i + 1] = _start[i] + m.row_sum(i);
+
+  _list.reserve(_start.back());
+
+  for(int i = 0; i < m.size(); ++i)
+    for(int j = m.next(i); j >= 0; j = m.next(i, j))
+      _list.push_back(j);
+}
+
+template <typename T>
+T ConList::row_sum (const ConMat<T>& m, int i) const
+{
+  T res = 0;
+  for(const int* j = begin(i); j != end(i); ++j)
+    res += m(i, *j);
+  return res;
+}
+
 // sort
 template <class T>
 void my_sort (const std::vector<T>& v, std::vector<int>& perm)
@@ -0,0 +1,201 @@
+#include "thread.hh"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+
+/*************************** Parallel execution ****************************/
+
+int thread_count = 1;
+
+int worker_count (int ntask)
+{
+  int res = thread_count;
+
+  if(res <= 0)
+    //
+    res = std::thread::hardware_concurrency();
+
+  if(res > ntask)
+    //
+    res = ntask;
+
+  if(res < 1)
+    //
+    res = 1;
+
+  return res;
+}
+
+// persistent pool of worker threads: the threads are started on demand and wait
+// for the next job between the parallel_for calls
+//
+class WorkerPool {
+  //
+  std::mutex _mutex;
+
+  std::condition_variable _start;
+  std::condition_variable _done;
+
+  std::vector<std::thread> _thread;
+
+  const std::function<void (int)>* _job;
+
+  int _nworker; // workers taking part in the current job, the calling thread included
+
+  int _running; // pool threads running the current job
+
+  unsigned long _generation; // job counter
+
+  bool _stop;
+
+  std::mutex _busy; // pool is running a job
+
+  void _loop (int);
+
+public:
+  //
+  WorkerPool () : _job(0), _nworker(0), _running(0), _generation(0), _stop(false) {}
+
+  ~WorkerPool ();
+
+  // false if the pool is busy, e.g., for the nested calls
+  //
+  bool run (int, const std::function<void (int)>&);
+};
+
+// the calling thread is one of the pool threads
+//
+static thread_local bool in_pool = false;
+
+void WorkerPool::_loop (int w)
+{
+  in_pool = true;
+
+  unsigned long seen = 0;
+
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  while(1) {
+    //
+    _start.wait(lock, [&] { return _stop || _generation != seen; });
+
+    if(_stop)
+      //
+      return;
+
+    seen = _generation;
+
+    if(w >= _nworker)
+      //
+      continue;
+
+    const std::function<void (int)>& job = *_job;
+
+    lock.unlock();
+
+    job(w);
+
+    lock.lock();
+
+    if(!--_running)
+      //
+      _done.notify_all();
+  }
+}
+
+WorkerPool::~WorkerPool ()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stop = true;
+  }
+
+  _start.notify_all();
+
+  for(std::vector<std::thread>::iterator it = _thread.begin(); it != _thread.end(); ++it)
+    //
+    it->join();
+}
+
+bool WorkerPool::run (int nworker, const std::function<void (int)>& job)
+{
+  if(in_pool || !_busy.try_lock())
+    //
+    return false;
+
+  std::lock_guard<std::mutex> busy(_busy, std::adopt_lock);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  // the pool threads have indices starting from one
+  //
+  while((int)_thread.size() < nworker - 1)
+    //
+    _thread.push_back(std::thread(&WorkerPool::_loop, this, (int)_thread.size() + 1));
+
+  _job = &job;
+
+  _nworker = nworker;
+
+  _running = nworker - 1;
+
+  ++_generation;
+
+  lock.unlock();
+
+  _start.notify_all();
+
+  job(0);
+
+  lock.lock();
+
+  _done.wait(lock, [&] { return !_running; });
+
+  return true;
+}
+
+static WorkerPool pool;
+
+void parallel_for (int ntask, const std::function<void (int, int)>& task)
+{
+  const int nworker = worker_count(ntask);
+
+  std::atomic<int> next(0);
+
+  std::vector<std::exception_ptr> error(nworker);
+
+  std::function<void (int)> work = [&] (int w) {
+    //
+    try {
+      //
+      for(int t = next++; t < ntask; t = next++)
+	//
+	task(t, w);
+    }
+    catch(...) {
+      //
+      error[w] = std::current_exception();
+
+      // stop handing out the tasks
+      //
+      next = ntask;
+    }
+  };
+
+  // the pool is busy: the tasks are run by the calling thread
+  //
+  if(nworker == 1 || !pool.run(nworker, work))
+    //
+    work(0);
+
+  for(int w = 0; w < nworker; ++w)
+    //
+    if(error[w])
+      //
+      std::rethrow_exception(error[w]);
+}
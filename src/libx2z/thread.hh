@@ -0,0 +1,23 @@
+#ifndef THREAD_HH
+#define THREAD_HH
+
+#include <functional>
+
+/*************************** Parallel execution ****************************/
+
+// number of worker threads; hardware concurrency if not positive
+//
+extern int thread_count;
+
+// number of workers used for given number of tasks
+//
+int worker_count (int);
+
+// runs the tasks on the persistent pool of worker threads: the tasks are handed out
+// dynamically, the calling thread is one of the workers, and the call returns when all
+// tasks are done; the nested calls run on the calling thread; the task function
+// arguments are the task and the worker indices
+//
+void parallel_for (int, const std::function<void (int, int)>&);
+
+#endif
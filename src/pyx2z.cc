@@ -1,8 +1,10 @@
 #include <vector>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 #include "libx2z/atom.hh"
 #include "libx2z/chem.hh"
+#include "libx2z/thread.hh"
 #include <sstream>
 
 namespace py = pybind11;
@@ -101,9 +103,48 @@ PYBIND11_MODULE(pyx2z, module) {
         .def(py::init<>())
         .def("size", [](MolecGeom& m) { return m.size(); })
         .def("push_back", [](MolecGeom& m, const Atom& a) { m.push_back(a); });
-    py::class_<MolecOrient>(module, "MolecOrient")
+    py::class_<MolecOrient> molec_orient(module, "MolecOrient");
+    py::enum_<MolecOrient::engine_t>(molec_orient, "Engine")
+        .value("GEOMETRIC", MolecOrient::GEOMETRIC)
+        .value("GRAPH", MolecOrient::GRAPH)
+        .export_values();
+    py::enum_<MolecOrient::top_t>(molec_orient, "Top")
+        .value("SPHERICAL_TOP", MolecOrient::SPHERICAL_TOP)
+        .value("SYMMETRIC_TOP", MolecOrient::SYMMETRIC_TOP)
+        .value("ASYMMETRIC_TOP", MolecOrient::ASYMMETRIC_TOP)
+        .export_values();
+    py::enum_<MolecOrient::mode_t>(molec_orient, "Mode")
+        .value("SYMNUM", MolecOrient::SYMNUM)
+        .value("TEST", MolecOrient::TEST)
+        .export_values();
+    py::class_<MolecOrient::SymOp>(molec_orient, "SymOp")
+        .def_readonly("perm", &MolecOrient::SymOp::perm)
+        .def_readonly("proper", &MolecOrient::SymOp::proper)
+        .def_property_readonly("rot", [](const MolecOrient::SymOp& op) {
+            std::vector<std::vector<double>> rot(3, std::vector<double>(3));
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    rot[i][j] = op.rot(i, j);
+            return rot;
+        })
+        .def("order", &MolecOrient::SymOp::order);
+    molec_orient
         .def(py::init<const MolecGeom&>())
+        .def("set_engine", &MolecOrient::set_engine)
+        .def("engine", &MolecOrient::engine)
+        .def("top", &MolecOrient::top)
+        .def("principal_moment", &MolecOrient::principal_moment)
+        .def("principal_axes", [](const MolecOrient& o) {
+            std::vector<std::vector<double>> pa(3, std::vector<double>(3));
+            for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                    pa[i][j] = o.principal_axes()(i, j);
+            return pa;
+        })
         .def("sym_num", &MolecOrient::sym_num)
+        .def("sym_ops", &MolecOrient::sym_ops)
+        .def("improper_ops", &MolecOrient::improper_ops)
+        .def("point_group", &MolecOrient::point_group)
         .def("is_enantiomer", &MolecOrient::is_enantiomer)
         .def("is_plane", &MolecOrient::is_plane)
         .def("is_linear", &MolecOrient::is_linear)
@@ -154,7 +195,97 @@ PYBIND11_MODULE(pyx2z, module) {
              (double (MolecStruct::*)(int, int) const)
              &MolecStruct::bond_order)
         .def("resonance_count", &MolecStruct::resonance_count)
+        .def("is_resonance_truncated", &MolecStruct::is_resonance_truncated)
+        .def("update_zmat_coval", &MolecStruct::update_zmat_coval)
+        .def("zmat_coval",
+             [](const MolecStruct& m) {
+                 const MultiArray<double>& coval = m.zmat_coval();
+                 py::array_t<double> res(std::vector<size_t>(
+                     {(size_t)coval.size(0), (size_t)coval.size(1)}));
+                 for (int i = 0; i < coval.size(0); ++i)
+                     for (int j = 0; j < coval.size(1); ++j)
+                         res.mutable_at(i, j) = coval(i, j);
+                 return res;
+             })
+        .def("zmat_var", &MolecStruct::zmat_var)
+        .def("zmat_trajectory",
+             [](const MolecStruct& m,
+                py::array_t<double, py::array::c_style | py::array::forcecast>
+                xyz) {
+                 if (xyz.ndim() != 3 || xyz.shape(1) != m.size() ||
+                     xyz.shape(2) != 3)
+                     throw std::invalid_argument(
+                         "zmat_trajectory: frames x atoms x 3 array expected");
+                 const int nframe = xyz.shape(0);
+                 py::array_t<double> table(std::vector<size_t>(
+                     {(size_t)nframe, m.zmat_var().size()}));
+                 m.zmat_trajectory(nframe, xyz.data(),
+                                   table.mutable_data());
+                 return table;
+             })
+        .def("zmat_cartesian",
+             [](const MolecStruct& m,
+                py::array_t<double, py::array::c_style | py::array::forcecast>
+                var) {
+                 if (var.ndim() != 2 || var.shape(1) != m.zmat_var().size())
+                     throw std::invalid_argument(
+                         "zmat_cartesian: sets x variables array expected");
+                 const int nset = var.shape(0);
+                 py::array_t<double> xyz(std::vector<size_t>(
+                     {(size_t)nset, (size_t)m.size(), 3}));
+                 m.zmat_cartesian(nset, var.data(), xyz.mutable_data());
+                 return xyz;
+             })
+        .def("bond", &MolecStruct::bond)
+        .def("resonances",
+             [](const MolecStruct& m) {
+                 return MolecStruct::ResonanceGenerator(
+                     m, std::chrono::steady_clock::now());
+             })
         .def("is_radical", &MolecStruct::is_radical);
+    py::class_<MolecStruct::ResonanceGenerator>(module, "ResonanceGenerator")
+        .def("__iter__",
+             [](MolecStruct::ResonanceGenerator& g)
+             -> MolecStruct::ResonanceGenerator& { return g; })
+        .def("__next__",
+             [](MolecStruct::ResonanceGenerator& g) {
+                 MolecStruct::Resonance res;
+                 if (!g.next(res))
+                     throw py::stop_iteration();
+                 return res;
+             })
+        .def("pi_bond_count",
+             &MolecStruct::ResonanceGenerator::pi_bond_count);
+    py::class_<RotorScan>(module, "RotorScan")
+        .def(py::init<const MolecStruct&,
+                      const std::vector<std::vector<double> >&, bool>(),
+             py::arg("mol"), py::arg("grid"), py::arg("unique") = true,
+             py::keep_alive<1, 2>())
+        .def("__iter__", [](RotorScan& s) -> RotorScan& { return s; })
+        .def("__next__",
+             [](RotorScan& s) {
+                 MolecGeom geom;
+                 std::vector<double> incr;
+                 if (!s.next(geom, incr))
+                     throw py::stop_iteration();
+                 return py::make_tuple(geom, incr);
+             })
+        .def("skipped", &RotorScan::skipped);
+    module.def("set_thread_count", [](int n) { thread_count = n; });
+    module.def("thread_count", []() { return thread_count; });
+    py::enum_<resonance_method_t>(module, "ResonanceMethod")
+        .value("MATCHING", RESONANCE_MATCHING)
+        .value("BFS", RESONANCE_BFS)
+        .export_values();
+    module.def("set_resonance_method",
+               [](resonance_method_t m) { resonance_method = m; });
+    module.def("resonance_method", []() { return resonance_method; });
+    module.def("set_resonance_limit", [](int n) { resonance_limit = n; });
+    module.def("resonance_limit", []() { return resonance_limit; });
+    module.def("set_resonance_time_limit",
+               [](double t) { resonance_time_limit = t; });
+    module.def("resonance_time_limit", []() { return resonance_time_limit; });
+    module.def("compare", &compare);
     module.def("zmatrix_string", &zmatrix_string);
     module.def("rotational_bond_coordinates", &rotational_bond_coordinates);
     module.def("rotational_group_indices", &rotational_group_indices);
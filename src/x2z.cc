@@ -8,6 +8,7 @@
 #include "libx2z/units.hh"
 #include "libx2z/chem.hh"
 #include "libx2z/math.hh"
+#include "libx2z/thread.hh"
 
 int main(int argc, const char* argv [])
 {
@@ -76,10 +77,24 @@ int main(int argc, const char* argv [])
   const std::string atol_key = "AngleTolerance";
   const std::string dtol_key = "DistanceTolerance[bohr]";
   const std::string bond_key = "IncipientBond";
+  const std::string syme_key = "SymmetryEngine";
+  const std::string thrd_key = "ThreadCount";
+  const std::string resm_key = "ResonanceMethod";
+  const std::string resl_key = "ResonanceLimit";
+  const std::string rest_key = "ResonanceTimeLimit[sec]";
 
   avail_keys.insert(atol_key);
   avail_keys.insert(dtol_key);
   avail_keys.insert(bond_key);
+  avail_keys.insert(syme_key);
+  avail_keys.insert(thrd_key);
+  avail_keys.insert(resm_key);
+  avail_keys.insert(resl_key);
+  avail_keys.insert(rest_key);
+
+  // symmetry number engine
+  //
+  MolecOrient::engine_t sym_engine = MolecOrient::GEOMETRIC;
 
   // input cycle
   //
@@ -161,6 +176,118 @@ int main(int argc, const char* argv [])
 
       ib.insert(bond);
     }
+    // number of worker threads
+    //
+    else if(thrd_key == token) {
+      //
+      if(!(from >> itemp)) {
+	//
+	std::cerr << funame << token << ": corrupted\n";
+	
+	return 1;
+      }
+      
+      if(itemp < 0) {
+	//
+	std::cerr << funame << token << ": out of range: " << itemp << "\n";
+
+	return 1;
+      }
+
+      thread_count = itemp;
+    }
+    // symmetry number engine
+    //
+    else if(syme_key == token) {
+      //
+      if(!(from >> token)) {
+	//
+	std::cerr << funame << syme_key << ": corrupted\n";
+	
+	return 1;
+      }
+
+      if(token == "Geometric") {
+	//
+	sym_engine = MolecOrient::GEOMETRIC;
+      }
+      else if(token == "Graph") {
+	//
+	sym_engine = MolecOrient::GRAPH;
+      }
+      else {
+	//
+	std::cerr << funame << syme_key << ": unknown engine: " << token << "\nAvailable engines:   Geometric   Graph\n";
+
+	return 1;
+      }
+    }
+    // resonances enumeration method
+    //
+    else if(resm_key == token) {
+      //
+      if(!(from >> token)) {
+	//
+	std::cerr << funame << resm_key << ": corrupted\n";
+	
+	return 1;
+      }
+
+      if(token == "Matching") {
+	//
+	resonance_method = RESONANCE_MATCHING;
+      }
+      else if(token == "BFS") {
+	//
+	resonance_method = RESONANCE_BFS;
+      }
+      else {
+	//
+	std::cerr << funame << resm_key << ": unknown method: " << token << "\nAvailable methods:   Matching   BFS\n";
+
+	return 1;
+      }
+    }
+    // maximal number of resonances
+    //
+    else if(resl_key == token) {
+      //
+      if(!(from >> itemp)) {
+	//
+	std::cerr << funame << token << ": corrupted\n";
+	
+	return 1;
+      }
+      
+      if(itemp < 0) {
+	//
+	std::cerr << funame << token << ": out of range: " << itemp << "\n";
+
+	return 1;
+      }
+
+      resonance_limit = itemp;
+    }
+    // resonances enumeration time limit
+    //
+    else if(rest_key == token) {
+      //
+      if(!(from >> dtemp)) {
+	//
+	std::cerr << funame << token << ": corrupted\n";
+	
+	return 1;
+      }
+      
+      if(dtemp < 0.) {
+	//
+	std::cerr << funame << token << ": out of range: " << dtemp << "\n";
+
+	return 1;
+      }
+
+      resonance_time_limit = dtemp;
+    }
     // unknown keyword
     //
     else {
@@ -180,6 +307,8 @@ int main(int argc, const char* argv [])
   
   MolecOrient mo(geom);
 
+  mo.set_engine(sym_engine);
+
   for(int a = 0; a < mo.size(); ++a)
     //
     std::cout << mo[a] << "\n";